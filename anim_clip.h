@@ -0,0 +1,229 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include <learnopengl/assimp_glm_helpers.h>
+
+#include "huge_pages.h"
+#include "import_profile.h"
+#include "skinned_model.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Node of the clip's hierarchy, stored parent-before-child
+struct ClipNode
+{
+    std::string name;
+    int parent;
+    glm::mat4 bindLocal;
+};
+
+// Keyframe storage; on huge pages with --huge-pages, since a crowd samples
+// keys scattered across every loaded clip each frame
+template <typename T>
+using KeyVector = std::vector<T, HugePageAllocator<T>>;
+
+// Keyframes of one animated node, each channel with its own time axis
+struct ClipTrack
+{
+    std::string nodeName;
+    KeyVector<float> positionTimes;
+    KeyVector<glm::vec3> positions;
+    KeyVector<float> rotationTimes;
+    KeyVector<glm::quat> rotations;
+    KeyVector<float> scaleTimes;
+    KeyVector<glm::vec3> scales;
+};
+
+// Local transform of one node in components, the form poses are blended in
+struct NodeTransform
+{
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+
+    glm::mat4 ToMatrix() const
+    {
+        return glm::translate(glm::mat4(1.0f), translation) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    }
+
+    // Inverse of ToMatrix for matrices without shear
+    static NodeTransform FromMatrix(const glm::mat4& m)
+    {
+        glm::vec3 scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+        glm::mat3 rotation(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z);
+        return { glm::vec3(m[3]), glm::normalize(glm::quat_cast(rotation)), scale };
+    }
+};
+
+// Keyframe data for one clip. Unlike Bone, sampling is const and keeps no
+// per-call state, so any number of characters can share a clip.
+class AnimClip
+{
+public:
+    float GetTicksPerSecond() const { return m_TicksPerSecond; }
+    float GetDuration() const { return m_Duration; }
+    const std::vector<ClipNode>& GetNodes() const { return m_Nodes; }
+    const std::vector<ClipTrack>& GetTracks() const { return m_Tracks; }
+    // Unique per clip ever created, unlike the address, which a reloaded
+    // clip may reuse after the old one is freed
+    uint64_t GetSerial() const { return m_Serial; }
+
+    // Keyframe times and values of every track, for comparing clip memory
+    size_t GetKeyframeBytes() const
+    {
+        size_t bytes = 0;
+        for (const ClipTrack& t : m_Tracks)
+            bytes += (t.positionTimes.size() + t.rotationTimes.size() + t.scaleTimes.size()) * sizeof(float)
+                + (t.positions.size() + t.scales.size()) * sizeof(glm::vec3) + t.rotations.size() * sizeof(glm::quat);
+        return bytes;
+    }
+
+    int FindTrack(const std::string& nodeName) const
+    {
+        for (size_t i = 0; i < m_Tracks.size(); ++i)
+            if (m_Tracks[i].nodeName == nodeName)
+                return (int)i;
+        return -1;
+    }
+
+    glm::mat4 SampleLocal(int track, float time) const
+    {
+        return SampleTransform(track, time).ToMatrix();
+    }
+
+    NodeTransform SampleTransform(int track, float time) const
+    {
+        const ClipTrack& t = m_Tracks[track];
+        return { SampleVec3(t.positionTimes, t.positions, time, glm::vec3(0.0f)),
+            SampleQuat(t.rotationTimes, t.rotations, time),
+            SampleVec3(t.scaleTimes, t.scales, time, glm::vec3(1.0f)) };
+    }
+
+    // Bones animated by the clip but not skinned by the model still need a
+    // palette slot, same as Animation::ReadMissingBones
+    void AddMissingBones(SkinnedModel* model) const
+    {
+        for (const ClipTrack& track : m_Tracks)
+            model->AddBone(track.nodeName, glm::mat4(1.0f));
+    }
+
+    static AnimClip* LoadAssimp(const std::string& path, SkinnedModel* model)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = ReadScene(importer, path, ConfigureImporter(importer, ImportProfile::AnimOnly));
+        if (!scene || !scene->mRootNode || scene->mNumAnimations == 0)
+        {
+            std::cout << "ERROR::ASSIMP:: no animation in " << path << ": " << importer.GetErrorString() << std::endl;
+            return nullptr;
+        }
+
+        const aiAnimation* animation = scene->mAnimations[0];
+        AnimClip* clip = new AnimClip();
+        clip->m_Duration = (float)animation->mDuration;
+        clip->m_TicksPerSecond = (float)animation->mTicksPerSecond;
+        clip->ReadHierarchy(scene->mRootNode, -1);
+
+        clip->m_Tracks.resize(animation->mNumChannels);
+        for (unsigned int i = 0; i < animation->mNumChannels; ++i)
+        {
+            const aiNodeAnim* channel = animation->mChannels[i];
+            ClipTrack& track = clip->m_Tracks[i];
+            track.nodeName = channel->mNodeName.C_Str();
+            for (unsigned int k = 0; k < channel->mNumPositionKeys; ++k)
+            {
+                const aiVectorKey& key = channel->mPositionKeys[k];
+                track.positionTimes.push_back((float)key.mTime);
+                track.positions.push_back(AssimpGLMHelpers::GetGLMVec(key.mValue));
+            }
+            for (unsigned int k = 0; k < channel->mNumRotationKeys; ++k)
+            {
+                const aiQuatKey& key = channel->mRotationKeys[k];
+                track.rotationTimes.push_back((float)key.mTime);
+                track.rotations.push_back(AssimpGLMHelpers::GetGLMQuat(key.mValue));
+            }
+            for (unsigned int k = 0; k < channel->mNumScalingKeys; ++k)
+            {
+                const aiVectorKey& key = channel->mScalingKeys[k];
+                track.scaleTimes.push_back((float)key.mTime);
+                track.scales.push_back(AssimpGLMHelpers::GetGLMVec(key.mValue));
+            }
+        }
+
+        clip->AddMissingBones(model);
+        return clip;
+    }
+
+private:
+    friend class GltfLoader;
+    friend class ClipMirror;
+
+    void ReadHierarchy(const aiNode* src, int parent)
+    {
+        ClipNode node;
+        node.name = src->mName.C_Str();
+        node.parent = parent;
+        node.bindLocal = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
+
+        int index = (int)m_Nodes.size();
+        m_Nodes.push_back(node);
+        for (unsigned int i = 0; i < src->mNumChildren; ++i)
+            ReadHierarchy(src->mChildren[i], index);
+    }
+
+    // Index of the last key at or before `time`
+    static int FindKey(const KeyVector<float>& times, float time)
+    {
+        auto it = std::upper_bound(times.begin(), times.end(), time);
+        return std::max(0, (int)(it - times.begin()) - 1);
+    }
+
+    static float GetFactor(const KeyVector<float>& times, int key, float time)
+    {
+        float span = times[key + 1] - times[key];
+        return span > 0.0f ? glm::clamp((time - times[key]) / span, 0.0f, 1.0f) : 0.0f;
+    }
+
+    static glm::vec3 SampleVec3(const KeyVector<float>& times, const KeyVector<glm::vec3>& values,
+        float time, const glm::vec3& fallback)
+    {
+        if (values.empty())
+            return fallback;
+        int key = FindKey(times, time);
+        if (key + 1 >= (int)values.size())
+            return values[key];
+        return glm::mix(values[key], values[key + 1], GetFactor(times, key, time));
+    }
+
+    static glm::quat SampleQuat(const KeyVector<float>& times, const KeyVector<glm::quat>& values, float time)
+    {
+        if (values.empty())
+            return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        int key = FindKey(times, time);
+        if (key + 1 >= (int)values.size())
+            return values[key];
+        return glm::normalize(glm::slerp(values[key], values[key + 1], GetFactor(times, key, time)));
+    }
+
+    float m_Duration = 0.0f;
+    float m_TicksPerSecond = 0.0f;
+    std::vector<ClipNode> m_Nodes;
+    std::vector<ClipTrack> m_Tracks;
+    uint64_t m_Serial = NextSerial();
+
+    static uint64_t NextSerial()
+    {
+        static std::atomic<uint64_t> next{ 1 };
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+};
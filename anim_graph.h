@@ -0,0 +1,636 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "anim_clip.h"
+#include "asset_handles.h"
+#include "pose_arena.h"
+#include "skeleton.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Animation graphs compiled to a flat program of pose operations.
+//
+// A graph is described once with AnimGraphBuilder (sample, blend, mask,
+// additive and IK nodes over named parameters) and compiled against a
+// skeleton at load time. Compilation orders the nodes, merges identical
+// ones, and gives every intermediate pose a statically assigned buffer slot,
+// reusing a slot as soon as its pose is dead and writing in place where an
+// input dies at the instruction. A character then runs straight-line
+// bytecode over a handful of pose buffers taken from its thread's arena.
+//
+// Nodes that depend only on shared parameters (clocks and weights set on the
+// graph, not on a character) form a separate program that BeginFrame runs
+// once per frame; every character using the graph reads those poses instead
+// of evaluating them again.
+enum class GraphOp : uint8_t
+{
+    Sample,    // dst = clip at a time parameter (seconds)
+    Blend,     // dst = mix(a, b, weight)
+    Mask,      // dst = mix(a, b, weight) below one bone only
+    Additive,  // dst = a + weight * (b - bind pose)
+    TwoBoneIK, // dst = a with a three-joint limb bent to reach a target
+};
+
+struct GraphInstruction
+{
+    GraphOp op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+    uint16_t param[2]; // weight, time or target operands
+    uint16_t data;     // clip, mask or chain index
+};
+
+class AnimGraph
+{
+public:
+    // Operand flags: the slot lives in the graph's shared poses, the
+    // parameter in its shared parameters
+    static const uint8_t SHARED_SLOT = 0x80;
+    static const uint16_t SHARED_PARAM = 0x8000;
+    static const uint16_t NO_PARAM = 0xFFFF;
+    static const int MAX_SLOTS = 0x7F;
+
+    // Main thread, inside the frame's EpochScope, before any character
+    // using the graph is evaluated: resolves clips, advances the shared
+    // clocks and evaluates the shared program
+    void BeginFrame(float dt)
+    {
+        for (ClipRef& ref : m_Clips)
+        {
+            ref.clip = ref.handle.IsValid() ? AssetHandles::clips.Resolve(ref.handle) : ref.fixed;
+            ref.tracks = ref.clip ? &m_Skeleton->BindClip(ref.clip) : nullptr;
+        }
+        for (uint16_t clock : m_SharedClocks)
+            m_SharedParams[clock] += dt;
+        Execute(m_SharedProgram, nullptr, m_SharedPoses.data(), m_SharedPoses.data());
+    }
+
+    // Runs the per-character program with that character's parameters. The
+    // result lives in arena scratch (or in the shared poses) and is valid
+    // until the caller's arena scope ends.
+    const NodeTransform* Evaluate(const float* params, PoseArena& arena) const
+    {
+        NodeTransform* slots = m_InstanceProgram.empty() ? nullptr
+            : arena.Allocate<NodeTransform>((size_t)m_InstanceSlotCount * m_NodeCount);
+        Execute(m_InstanceProgram, params, slots, m_SharedPoses.data());
+        return (m_Output & SHARED_SLOT) ? &m_SharedPoses[(m_Output & ~SHARED_SLOT) * m_NodeCount] : &slots[m_Output * m_NodeCount];
+    }
+
+    // Per-character parameters start from these; clocks are advanced by
+    // CharacterAnimator::AdvanceTime
+    const std::vector<float>& GetInstanceDefaults() const { return m_InstanceDefaults; }
+    const std::vector<uint16_t>& GetInstanceClocks() const { return m_InstanceClocks; }
+
+    void SetShared(uint16_t param, float value) { m_SharedParams[param & ~SHARED_PARAM] = value; }
+    float GetShared(uint16_t param) const { return m_SharedParams[param & ~SHARED_PARAM]; }
+
+    Skeleton* GetSkeleton() const { return m_Skeleton; }
+
+    void Report() const
+    {
+        std::printf("anim graph: %zu shared + %zu per-character instructions, %d + %d pose slots (%zu KB scratch per character)\n",
+            m_SharedProgram.size(), m_InstanceProgram.size(), m_SharedSlotCount, m_InstanceSlotCount,
+            (size_t)m_InstanceSlotCount * m_NodeCount * sizeof(NodeTransform) / 1024);
+    }
+
+private:
+    friend class AnimGraphBuilder;
+
+    struct ClipRef
+    {
+        ClipHandle handle;
+        const AnimClip* fixed = nullptr;
+        // Resolved by BeginFrame
+        const AnimClip* clip = nullptr;
+        const std::vector<int>* tracks = nullptr;
+    };
+
+    struct Chain
+    {
+        int root;
+        int mid;
+        int end;
+    };
+
+    float ReadParam(uint16_t operand, const float* params) const
+    {
+        return (operand & SHARED_PARAM) ? m_SharedParams[operand & ~SHARED_PARAM] : params[operand];
+    }
+
+    void Execute(const std::vector<GraphInstruction>& program, const float* params, NodeTransform* slots,
+        const NodeTransform* shared) const
+    {
+        size_t n = m_NodeCount;
+        auto input = [&](uint8_t operand) {
+            return (operand & SHARED_SLOT) ? shared + (operand & ~SHARED_SLOT) * n : slots + operand * n;
+        };
+        for (const GraphInstruction& instruction : program)
+        {
+            NodeTransform* dst = slots + (instruction.dst & ~SHARED_SLOT) * n;
+            switch (instruction.op)
+            {
+            case GraphOp::Sample:
+                SamplePose(dst, m_Clips[instruction.data], ReadParam(instruction.param[0], params));
+                break;
+            case GraphOp::Blend:
+                BlendPoses(dst, input(instruction.a), input(instruction.b), ReadParam(instruction.param[0], params), nullptr);
+                break;
+            case GraphOp::Mask:
+                BlendPoses(dst, input(instruction.a), input(instruction.b), ReadParam(instruction.param[0], params),
+                    m_Masks[instruction.data].data());
+                break;
+            case GraphOp::Additive:
+                AddPose(dst, input(instruction.a), input(instruction.b), ReadParam(instruction.param[0], params));
+                break;
+            case GraphOp::TwoBoneIK:
+            {
+                uint16_t target = instruction.param[0];
+                glm::vec3 position(ReadParam(target, params), ReadParam(target + 1, params), ReadParam(target + 2, params));
+                SolveTwoBone(dst, input(instruction.a), m_Chains[instruction.data], position,
+                    ReadParam(instruction.param[1], params));
+                break;
+            }
+            }
+        }
+    }
+
+    void SamplePose(NodeTransform* dst, const ClipRef& ref, float seconds) const
+    {
+        if (!ref.clip || ref.clip->GetDuration() <= 0.0f)
+        {
+            std::copy(m_BindPose.begin(), m_BindPose.end(), dst);
+            return;
+        }
+        float ticks = std::fmod(seconds * ref.clip->GetTicksPerSecond(), ref.clip->GetDuration());
+        if (ticks < 0.0f)
+            ticks += ref.clip->GetDuration();
+        const std::vector<int>& tracks = *ref.tracks;
+        for (size_t i = 0; i < m_NodeCount; ++i)
+            dst[i] = tracks[i] >= 0 ? ref.clip->SampleTransform(tracks[i], ticks) : m_BindPose[i];
+    }
+
+    static NodeTransform Mix(const NodeTransform& a, const NodeTransform& b, float weight)
+    {
+        // nlerp along the shorter arc: close enough to slerp for pose blending
+        glm::quat to = glm::dot(a.rotation, b.rotation) < 0.0f ? -b.rotation : b.rotation;
+        return { glm::mix(a.translation, b.translation, weight),
+            glm::normalize(a.rotation * (1.0f - weight) + to * weight),
+            glm::mix(a.scale, b.scale, weight) };
+    }
+
+    // dst may alias a or b
+    void BlendPoses(NodeTransform* dst, const NodeTransform* a, const NodeTransform* b, float weight, const float* mask) const
+    {
+        weight = glm::clamp(weight, 0.0f, 1.0f);
+        if (!mask && (weight == 0.0f || weight == 1.0f))
+        {
+            const NodeTransform* source = weight == 0.0f ? a : b;
+            if (source != dst)
+                std::memcpy((void*)dst, source, m_NodeCount * sizeof(NodeTransform));
+            return;
+        }
+        for (size_t i = 0; i < m_NodeCount; ++i)
+            dst[i] = Mix(a[i], b[i], mask ? weight * mask[i] : weight);
+    }
+
+    // The additive pose is stored absolute; its difference from the bind
+    // pose is what gets layered on top
+    void AddPose(NodeTransform* dst, const NodeTransform* base, const NodeTransform* additive, float weight) const
+    {
+        for (size_t i = 0; i < m_NodeCount; ++i)
+        {
+            const NodeTransform& bind = m_BindPose[i];
+            glm::quat delta = glm::inverse(bind.rotation) * additive[i].rotation;
+            glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+            NodeTransform result;
+            result.translation = base[i].translation + weight * (additive[i].translation - bind.translation);
+            result.rotation = glm::normalize(base[i].rotation * glm::slerp(identity, delta, weight));
+            result.scale = base[i].scale * glm::mix(glm::vec3(1.0f), additive[i].scale / bind.scale, weight);
+            dst[i] = result;
+        }
+    }
+
+    static glm::quat GetRotation(const glm::mat4& m)
+    {
+        return glm::quat_cast(glm::mat3(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])), glm::normalize(glm::vec3(m[2]))));
+    }
+
+    // Analytic two-bone IK in model space: bends the middle joint to get the
+    // right root-to-end distance, then swings the root to point at the target
+    void SolveTwoBone(NodeTransform* dst, const NodeTransform* src, const Chain& chain, const glm::vec3& target, float weight) const
+    {
+        if (dst != src)
+            std::memcpy((void*)dst, src, m_NodeCount * sizeof(NodeTransform));
+        weight = glm::clamp(weight, 0.0f, 1.0f);
+        if (weight == 0.0f)
+            return;
+
+        const std::vector<SkeletonNode>& nodes = m_Skeleton->GetNodes();
+        glm::mat4 parent(1.0f);
+        for (int node = nodes[chain.root].parent; node >= 0; node = nodes[node].parent)
+            parent = dst[node].ToMatrix() * parent;
+        glm::mat4 rootGlobal = parent * dst[chain.root].ToMatrix();
+        glm::mat4 midGlobal = rootGlobal * dst[chain.mid].ToMatrix();
+        glm::mat4 endGlobal = midGlobal * dst[chain.end].ToMatrix();
+
+        glm::vec3 a(rootGlobal[3]), b(midGlobal[3]), c(endGlobal[3]);
+        float lab = glm::length(b - a);
+        float lcb = glm::length(b - c);
+        const float eps = 1e-4f;
+        if (lab < eps || lcb < eps || glm::length(c - a) < eps || glm::length(target - a) < eps)
+            return;
+        float lat = glm::clamp(glm::length(target - a), eps, lab + lcb - eps);
+
+        auto angle = [](const glm::vec3& u, const glm::vec3& v) {
+            return std::acos(glm::clamp(glm::dot(glm::normalize(u), glm::normalize(v)), -1.0f, 1.0f));
+        };
+        float acab0 = angle(c - a, b - a);
+        float babc0 = angle(a - b, c - b);
+        float acat0 = angle(c - a, target - a);
+        float acab1 = std::acos(glm::clamp((lcb * lcb - lab * lab - lat * lat) / (-2.0f * lab * lat), -1.0f, 1.0f));
+        float babc1 = std::acos(glm::clamp((lat * lat - lab * lab - lcb * lcb) / (-2.0f * lab * lcb), -1.0f, 1.0f));
+
+        glm::vec3 bendAxis = glm::cross(c - a, b - a);
+        if (glm::length(bendAxis) < eps)
+            return; // straight limb: no plane to bend in
+        bendAxis = glm::normalize(bendAxis);
+        glm::vec3 swingAxis = glm::cross(c - a, target - a);
+        swingAxis = glm::length(swingAxis) < eps ? bendAxis : glm::normalize(swingAxis);
+
+        glm::quat rootRotation = GetRotation(rootGlobal);
+        glm::quat midRotation = GetRotation(midGlobal);
+        glm::quat r0 = glm::angleAxis(acab1 - acab0, glm::inverse(rootRotation) * bendAxis);
+        glm::quat r1 = glm::angleAxis(babc1 - babc0, glm::inverse(midRotation) * bendAxis);
+        glm::quat r2 = glm::angleAxis(acat0, glm::inverse(rootRotation) * swingAxis);
+
+        NodeTransform& root = dst[chain.root];
+        NodeTransform& mid = dst[chain.mid];
+        root.rotation = glm::normalize(glm::slerp(root.rotation, root.rotation * (r2 * r0), weight));
+        mid.rotation = glm::normalize(glm::slerp(mid.rotation, mid.rotation * r1, weight));
+    }
+
+    Skeleton* m_Skeleton = nullptr;
+    size_t m_NodeCount = 0;
+    std::vector<NodeTransform> m_BindPose;
+
+    std::vector<GraphInstruction> m_SharedProgram;
+    std::vector<GraphInstruction> m_InstanceProgram;
+    int m_SharedSlotCount = 0;
+    int m_InstanceSlotCount = 0;
+    uint8_t m_Output = 0;
+
+    std::vector<ClipRef> m_Clips;
+    std::vector<std::vector<float>> m_Masks;
+    std::vector<Chain> m_Chains;
+
+    std::vector<float> m_InstanceDefaults;
+    std::vector<uint16_t> m_InstanceClocks;
+    std::vector<float> m_SharedParams;
+    std::vector<uint16_t> m_SharedClocks;
+    std::vector<NodeTransform> m_SharedPoses;
+};
+
+// Describes a graph; Compile() turns it into an AnimGraph for one skeleton.
+// Parameter ids are the operands the compiled graph uses: pass instance ids
+// to CharacterAnimator::SetParameter and shared ids to AnimGraph::SetShared.
+class AnimGraphBuilder
+{
+public:
+    using Node = int;
+
+    uint16_t AddParameter(float value = 0.0f, bool shared = false)
+    {
+        return AddParameter(value, shared, false);
+    }
+
+    // Seconds, advanced every frame: by BeginFrame when shared, else by
+    // each character's AdvanceTime
+    uint16_t AddClock(bool shared = false, float start = 0.0f)
+    {
+        return AddParameter(start, shared, true);
+    }
+
+    // Three consecutive parameters (x, y, z); returns the first
+    uint16_t AddVectorParameter(const glm::vec3& value, bool shared = false)
+    {
+        uint16_t first = AddParameter(value.x, shared);
+        AddParameter(value.y, shared);
+        AddParameter(value.z, shared);
+        return first;
+    }
+
+    Node Sample(ClipHandle clip, uint16_t time)
+    {
+        NodeDef node(GraphOp::Sample);
+        node.handle = clip;
+        node.param[0] = time;
+        return AddNode(node);
+    }
+
+    // For clips that are not in AssetHandles (tools, the benchmark)
+    Node Sample(const AnimClip* clip, uint16_t time)
+    {
+        NodeDef node(GraphOp::Sample);
+        node.clip = clip;
+        node.param[0] = time;
+        return AddNode(node);
+    }
+
+    Node Blend(Node a, Node b, uint16_t weight)
+    {
+        NodeDef node(GraphOp::Blend);
+        node.a = a;
+        node.b = b;
+        node.param[0] = weight;
+        return AddNode(node);
+    }
+
+    // Layers `layer` over `base` on `bone` and everything below it
+    Node Mask(Node base, Node layer, const std::string& bone, uint16_t weight)
+    {
+        NodeDef node(GraphOp::Mask);
+        node.a = base;
+        node.b = layer;
+        node.param[0] = weight;
+        node.bones[0] = bone;
+        return AddNode(node);
+    }
+
+    Node Additive(Node base, Node additive, uint16_t weight)
+    {
+        NodeDef node(GraphOp::Additive);
+        node.a = base;
+        node.b = additive;
+        node.param[0] = weight;
+        return AddNode(node);
+    }
+
+    // root -> mid -> end must be a parent-child chain (shoulder, elbow,
+    // wrist); target is a vector parameter in model space
+    Node TwoBoneIK(Node input, const std::string& root, const std::string& mid, const std::string& end,
+        uint16_t target, uint16_t weight)
+    {
+        NodeDef node(GraphOp::TwoBoneIK);
+        node.a = input;
+        node.param[0] = target;
+        node.param[1] = weight;
+        node.bones[0] = root;
+        node.bones[1] = mid;
+        node.bones[2] = end;
+        return AddNode(node);
+    }
+
+    // nullptr (with a message) when a bone is missing or the graph needs
+    // more pose slots than an instruction can address
+    AnimGraph* Compile(Node output, Skeleton* skeleton) const
+    {
+        if (output < 0 || output >= (Node)m_Nodes.size())
+            return nullptr;
+
+        std::vector<Node> order;
+        std::vector<char> visited(m_Nodes.size(), 0);
+        Visit(output, visited, order);
+
+        // A node is shared when nothing under it reads a per-character parameter
+        std::vector<char> shared(m_Nodes.size(), 0);
+        for (Node n : order)
+        {
+            const NodeDef& node = m_Nodes[n];
+            bool isShared = true;
+            for (uint16_t param : node.param)
+                if (param != AnimGraph::NO_PARAM && !(param & AnimGraph::SHARED_PARAM))
+                    isShared = false;
+            for (Node input : { node.a, node.b })
+                if (input >= 0 && !shared[input])
+                    isShared = false;
+            shared[n] = isShared;
+        }
+
+        AnimGraph* graph = new AnimGraph();
+        graph->m_Skeleton = skeleton;
+        const std::vector<SkeletonNode>& nodes = skeleton->GetNodes();
+        graph->m_NodeCount = nodes.size();
+        for (const SkeletonNode& node : nodes)
+            graph->m_BindPose.push_back(NodeTransform::FromMatrix(node.bindLocal));
+        for (size_t p = 0; p < m_Params.size(); ++p)
+        {
+            const ParamDef& param = m_Params[p];
+            std::vector<float>& values = param.shared ? graph->m_SharedParams : graph->m_InstanceDefaults;
+            if (param.clock)
+                (param.shared ? graph->m_SharedClocks : graph->m_InstanceClocks).push_back((uint16_t)values.size());
+            values.push_back(param.value);
+        }
+
+        std::vector<int> slots(m_Nodes.size(), -1);
+        for (int program = 0; program < 2; ++program)
+        {
+            bool sharedProgram = program == 0;
+            std::vector<Node> list;
+            for (Node n : order)
+                if ((bool)shared[n] == sharedProgram)
+                    list.push_back(n);
+
+            // Last instruction in this program reading each node. Shared
+            // poses that per-character code (or the output) reads stay live
+            // for the whole frame.
+            std::vector<int> lastUse(m_Nodes.size(), -1);
+            for (size_t pos = 0; pos < list.size(); ++pos)
+                for (Node input : { m_Nodes[list[pos]].a, m_Nodes[list[pos]].b })
+                    if (input >= 0)
+                        lastUse[input] = (int)pos;
+            for (Node n : order)
+                for (Node input : { m_Nodes[n].a, m_Nodes[n].b })
+                    if (input >= 0 && shared[input] && !shared[n])
+                        lastUse[input] = INT32_MAX;
+            lastUse[output] = INT32_MAX;
+
+            std::vector<int> freeSlots;
+            int slotCount = 0;
+            for (size_t pos = 0; pos < list.size(); ++pos)
+            {
+                Node n = list[pos];
+                const NodeDef& node = m_Nodes[n];
+                int dst = -1;
+                for (Node input : { node.a, node.b })
+                {
+                    if (input < 0 || (bool)shared[input] != sharedProgram || lastUse[input] != (int)pos)
+                        continue;
+                    // Write in place over the first input that dies here
+                    if (dst < 0)
+                        dst = slots[input];
+                    else if (slots[input] != dst)
+                        freeSlots.push_back(slots[input]);
+                }
+                if (dst < 0)
+                {
+                    if (!freeSlots.empty())
+                    {
+                        auto lowest = std::min_element(freeSlots.begin(), freeSlots.end());
+                        dst = *lowest;
+                        freeSlots.erase(lowest);
+                    }
+                    else
+                        dst = slotCount++;
+                }
+                slots[n] = dst;
+                if (slotCount > AnimGraph::MAX_SLOTS)
+                {
+                    std::printf("ANIMGRAPH: more than %d live poses\n", AnimGraph::MAX_SLOTS);
+                    delete graph;
+                    return nullptr;
+                }
+
+                GraphInstruction instruction = {};
+                instruction.op = node.op;
+                instruction.dst = (uint8_t)(dst | (sharedProgram ? AnimGraph::SHARED_SLOT : 0));
+                auto operand = [&](Node input) {
+                    return input < 0 ? (uint8_t)0 : (uint8_t)(slots[input] | (shared[input] ? AnimGraph::SHARED_SLOT : 0));
+                };
+                instruction.a = operand(node.a);
+                instruction.b = operand(node.b);
+                instruction.param[0] = node.param[0];
+                instruction.param[1] = node.param[1];
+                if (!Resolve(node, *graph, instruction.data))
+                {
+                    delete graph;
+                    return nullptr;
+                }
+                (sharedProgram ? graph->m_SharedProgram : graph->m_InstanceProgram).push_back(instruction);
+            }
+            (sharedProgram ? graph->m_SharedSlotCount : graph->m_InstanceSlotCount) = slotCount;
+        }
+
+        graph->m_Output = (uint8_t)(slots[output] | (shared[output] ? AnimGraph::SHARED_SLOT : 0));
+        graph->m_SharedPoses.resize((size_t)graph->m_SharedSlotCount * graph->m_NodeCount);
+        return graph;
+    }
+
+private:
+    struct ParamDef
+    {
+        float value;
+        bool shared;
+        bool clock;
+    };
+
+    struct NodeDef
+    {
+        explicit NodeDef(GraphOp op) : op(op) {}
+
+        GraphOp op;
+        Node a = -1;
+        Node b = -1;
+        uint16_t param[2] = { AnimGraph::NO_PARAM, AnimGraph::NO_PARAM };
+        ClipHandle handle;
+        const AnimClip* clip = nullptr;
+        std::string bones[3];
+
+        bool operator==(const NodeDef& other) const
+        {
+            return op == other.op && a == other.a && b == other.b && param[0] == other.param[0] && param[1] == other.param[1]
+                && handle == other.handle && clip == other.clip
+                && bones[0] == other.bones[0] && bones[1] == other.bones[1] && bones[2] == other.bones[2];
+        }
+    };
+
+    uint16_t AddParameter(float value, bool shared, bool clock)
+    {
+        uint16_t index = 0;
+        for (const ParamDef& param : m_Params)
+            if (param.shared == shared)
+                index++;
+        m_Params.push_back({ value, shared, clock });
+        return shared ? (uint16_t)(index | AnimGraph::SHARED_PARAM) : index;
+    }
+
+    // Identical nodes (same op, inputs and parameters) are built once, so a
+    // subgraph written twice is also evaluated once
+    Node AddNode(const NodeDef& node)
+    {
+        for (size_t i = 0; i < m_Nodes.size(); ++i)
+            if (m_Nodes[i] == node)
+                return (Node)i;
+        m_Nodes.push_back(node);
+        return (Node)m_Nodes.size() - 1;
+    }
+
+    // Inputs before the node itself
+    void Visit(Node n, std::vector<char>& visited, std::vector<Node>& order) const
+    {
+        if (visited[n])
+            return;
+        visited[n] = 1;
+        for (Node input : { m_Nodes[n].a, m_Nodes[n].b })
+            if (input >= 0)
+                Visit(input, visited, order);
+        order.push_back(n);
+    }
+
+    // Fills the instruction's data index (clip, mask or chain)
+    bool Resolve(const NodeDef& node, AnimGraph& graph, uint16_t& data) const
+    {
+        Skeleton* skeleton = graph.m_Skeleton;
+        switch (node.op)
+        {
+        case GraphOp::Sample:
+        {
+            AnimGraph::ClipRef ref;
+            ref.handle = node.handle;
+            ref.fixed = node.clip;
+            data = (uint16_t)graph.m_Clips.size();
+            graph.m_Clips.push_back(ref);
+            return true;
+        }
+        case GraphOp::Mask:
+        {
+            int bone = skeleton->FindNode(node.bones[0]);
+            if (bone < 0)
+            {
+                std::printf("ANIMGRAPH: no bone named %s\n", node.bones[0].c_str());
+                return false;
+            }
+            // Parents come first, so one pass marks the whole subtree
+            const std::vector<SkeletonNode>& nodes = skeleton->GetNodes();
+            std::vector<float> mask(nodes.size(), 0.0f);
+            mask[bone] = 1.0f;
+            for (size_t i = bone + 1; i < nodes.size(); ++i)
+                if (nodes[i].parent >= 0)
+                    mask[i] = mask[nodes[i].parent];
+            data = (uint16_t)graph.m_Masks.size();
+            graph.m_Masks.push_back(mask);
+            return true;
+        }
+        case GraphOp::TwoBoneIK:
+        {
+            AnimGraph::Chain chain = { skeleton->FindNode(node.bones[0]), skeleton->FindNode(node.bones[1]),
+                skeleton->FindNode(node.bones[2]) };
+            const std::vector<SkeletonNode>& nodes = skeleton->GetNodes();
+            if (chain.root < 0 || chain.mid < 0 || chain.end < 0
+                || nodes[chain.mid].parent != chain.root || nodes[chain.end].parent != chain.mid)
+            {
+                std::printf("ANIMGRAPH: %s -> %s -> %s is not a bone chain\n",
+                    node.bones[0].c_str(), node.bones[1].c_str(), node.bones[2].c_str());
+                return false;
+            }
+            data = (uint16_t)graph.m_Chains.size();
+            graph.m_Chains.push_back(chain);
+            return true;
+        }
+        default:
+            data = 0;
+            return true;
+        }
+    }
+
+    std::vector<ParamDef> m_Params;
+    std::vector<NodeDef> m_Nodes;
+};
@@ -1,11 +1,48 @@
 #version 330 core
-out vec4 FragColor;
 
-in vec2 TexCoords;
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
 
-uniform sampler2D texture_diffuse1;
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+uniform mat4 finalBonesMatrices[MAX_BONES];
+
+// Palette slot of the socket a rigid prop is attached to, -1 for skinned meshes
+uniform int rigidBone = -1;
+
+out vec2 TexCoords;
 
 void main()
-{    
-    FragColor = texture(texture_diffuse1, TexCoords);
+{
+    vec4 totalPosition = vec4(0.0f);
+    if (rigidBone >= 0)
+    {
+        totalPosition = finalBonesMatrices[rigidBone] * vec4(pos, 1.0f);
+    }
+    else
+    {
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            if (boneIds[i] == -1)
+                continue;
+            if (boneIds[i] >= MAX_BONES)
+            {
+                totalPosition = vec4(pos, 1.0f);
+                break;
+            }
+            vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos, 1.0f);
+            totalPosition += localPosition * weights[i];
+        }
+    }
+
+    mat4 viewModel = view * model;
+    gl_Position = projection * viewModel * totalPosition;
+    TexCoords = tex;
 }
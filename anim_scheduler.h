@@ -0,0 +1,198 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "character_animator.h"
+#include "frustum.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Spends a fixed slice of the frame on pose evaluation. Every character's
+// playhead advances each frame, but the hierarchy pass only runs for the most
+// important characters until the budget is used up; the rest keep showing
+// their last pose and catch up the next time they are picked.
+//
+// With a job system the picked characters are evaluated in parallel batches,
+// still in importance order; the budget is then wall time, so more threads
+// fit more characters into the same slice. Each character's evaluation only
+// touches its own pose (plus the evaluating thread's scratch), so a palette is
+// bitwise identical whichever thread, and however many, produced it; only the
+// budget, being wall time, decides who is evaluated.
+class AnimationScheduler
+{
+public:
+    struct Stats
+    {
+        int evaluated = 0;
+        int skipped = 0;
+        float spentMs = 0.0f;
+        float avgEvaluateMs = 0.0f;
+        int maxStaleFrames = 0;
+    };
+
+    float budgetMs = 2.0f;
+    JobSystem* jobs = nullptr; // null: evaluate on the calling thread
+
+    // position must stay valid while the character is registered
+    void Add(CharacterAnimator* animator, const glm::vec3* position, float boundingRadius = 1.0f)
+    {
+        m_Entries.push_back({ animator, position, boundingRadius, 0, 0.0f });
+    }
+
+    void Remove(CharacterAnimator* animator)
+    {
+        m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(),
+            [animator](const Entry& e) { return e.animator == animator; }), m_Entries.end());
+    }
+
+    void Update(float dt, const glm::vec3& cameraPosition, const glm::mat4& viewProjection)
+    {
+        Clock::time_point start = Clock::now();
+
+        Frustum frustum(viewProjection);
+        m_Order.clear();
+        for (size_t i = 0; i < m_Entries.size(); ++i)
+        {
+            Entry& e = m_Entries[i];
+            e.animator->AdvanceTime(dt);
+
+            // Near, on-screen characters first; staleness lets distant and
+            // hidden ones climb the list so nobody is starved forever.
+            float distance = glm::length(*e.position - cameraPosition);
+            bool visible = frustum.IsSphereVisible(*e.position, e.boundingRadius);
+            e.importance = (visible ? 1.0f : 0.1f) * (1.0f + e.staleFrames) / (1.0f + distance);
+            m_Order.push_back((int)i);
+        }
+        std::sort(m_Order.begin(), m_Order.end(),
+            [this](int a, int b) { return m_Entries[a].importance > m_Entries[b].importance; });
+
+        m_Stats = Stats();
+        if (jobs && jobs->GetWorkerCount() > 0)
+            EvaluateParallel(start);
+        else
+            EvaluateSerial(start);
+
+        m_Stats.spentMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        m_Stats.avgEvaluateMs = m_AvgEvaluateSeconds * 1000.0f;
+        m_TotalSkipped += m_Stats.skipped;
+    }
+
+    const Stats& GetStats() const { return m_Stats; }
+
+    void Report() const
+    {
+        std::printf("anim scheduler: %d characters, budget %.2f ms, spent %.3f ms, evaluated %d, skipped %d "
+            "(max %d frames stale, %lld skipped total), %.4f ms per evaluation\n",
+            (int)m_Entries.size(), budgetMs, m_Stats.spentMs, m_Stats.evaluated, m_Stats.skipped,
+            m_Stats.maxStaleFrames, m_TotalSkipped, m_Stats.avgEvaluateMs);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void EvaluateSerial(Clock::time_point start)
+    {
+        float budgetSeconds = budgetMs * 0.001f;
+        for (int index : m_Order)
+        {
+            Entry& e = m_Entries[index];
+            float elapsed = std::chrono::duration<float>(Clock::now() - start).count();
+
+            // The most important character is always evaluated; after that stop
+            // before an evaluation is expected to cross the budget.
+            bool fits = m_Stats.evaluated == 0 || elapsed + m_AvgEvaluateSeconds <= budgetSeconds;
+            if (fits && e.animator->IsPoseDirty())
+            {
+                Clock::time_point evalStart = Clock::now();
+                e.animator->Evaluate();
+                float cost = std::chrono::duration<float>(Clock::now() - evalStart).count();
+                m_AvgEvaluateSeconds += (cost - m_AvgEvaluateSeconds) * 0.05f;
+                e.staleFrames = 0;
+                m_Stats.evaluated++;
+            }
+            else if (e.animator->IsPoseDirty())
+            {
+                e.staleFrames++;
+                m_Stats.skipped++;
+                m_Stats.maxStaleFrames = std::max(m_Stats.maxStaleFrames, e.staleFrames);
+            }
+        }
+    }
+
+    // Batches of a few characters per thread. A batch is trimmed to what the
+    // remaining budget fits at the running per-character cost; whatever is
+    // still dirty afterwards is counted stale, as in the serial path.
+    void EvaluateParallel(Clock::time_point start)
+    {
+        const size_t threads = jobs->GetWorkerCount() + 1;
+        const float budgetSeconds = budgetMs * 0.001f;
+        size_t next = 0;
+        while (next < m_Order.size())
+        {
+            m_Batch.clear();
+            for (; next < m_Order.size() && m_Batch.size() < threads * 4; ++next)
+                if (m_Entries[m_Order[next]].animator->IsPoseDirty())
+                    m_Batch.push_back(m_Order[next]);
+            if (m_Batch.empty())
+                break;
+
+            // Clamped before converting: past the budget `remaining` is
+            // negative, and a negative float to size_t is undefined
+            float remaining = std::max(0.0f, budgetSeconds - std::chrono::duration<float>(Clock::now() - start).count());
+            size_t fits = m_Batch.size();
+            if (m_AvgEvaluateSeconds > 0.0f)
+                fits = (size_t)std::min(remaining / m_AvgEvaluateSeconds, (float)m_Batch.size()) * threads;
+            if (m_Stats.evaluated == 0)
+                fits = std::max<size_t>(fits, 1);
+            if (fits == 0)
+                break;
+            bool trimmed = fits < m_Batch.size();
+            if (trimmed)
+                m_Batch.resize(fits);
+
+            Clock::time_point batchStart = Clock::now();
+            jobs->ParallelFor(m_Batch.size(), [this](size_t i) { m_Entries[m_Batch[i]].animator->Evaluate(); });
+            float batchSeconds = std::chrono::duration<float>(Clock::now() - batchStart).count();
+
+            // Per character, as seen on the wall clock with every thread busy
+            float cost = batchSeconds * std::min(threads, m_Batch.size()) / m_Batch.size();
+            m_AvgEvaluateSeconds += (cost - m_AvgEvaluateSeconds) * 0.05f;
+            for (int index : m_Batch)
+                m_Entries[index].staleFrames = 0;
+            m_Stats.evaluated += (int)m_Batch.size();
+            if (trimmed)
+                break;
+        }
+
+        for (int index : m_Order)
+        {
+            Entry& e = m_Entries[index];
+            if (e.animator->IsPoseDirty())
+            {
+                e.staleFrames++;
+                m_Stats.skipped++;
+                m_Stats.maxStaleFrames = std::max(m_Stats.maxStaleFrames, e.staleFrames);
+            }
+        }
+    }
+
+    struct Entry
+    {
+        CharacterAnimator* animator;
+        const glm::vec3* position;
+        float boundingRadius;
+        int staleFrames;
+        float importance;
+    };
+
+    std::vector<Entry> m_Entries;
+    std::vector<int> m_Order;
+    std::vector<int> m_Batch;
+    Stats m_Stats;
+    float m_AvgEvaluateSeconds = 0.0f;
+    long long m_TotalSkipped = 0;
+};
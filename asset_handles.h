@@ -0,0 +1,19 @@
+#pragma once
+
+#include "anim_clip.h"
+#include "handle_table.h"
+#include "skinned_model.h"
+
+// Loaded assets are owned by these tables and referred to by handle, so a
+// loader thread can publish or hot-reload an asset while the render and
+// animation threads resolve handles without taking a lock. A pointer from
+// Resolve() is good for the current frame (see Epoch in handle_table.h);
+// anything kept across frames should be the handle.
+using ModelHandle = Handle<SkinnedModel>;
+using ClipHandle = Handle<AnimClip>;
+
+namespace AssetHandles
+{
+    inline HandleTable<SkinnedModel> models;
+    inline HandleTable<AnimClip> clips;
+}
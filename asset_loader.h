@@ -0,0 +1,200 @@
+#pragma once
+
+#include "anim_clip.h"
+#include "async_io.h"
+#include "baked_model.h"
+#include "gltf_loader.h"
+#include "import_profile.h"
+#include "memory_stats.h"
+#include "skinned_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Picks the loader for each asset: an up-to-date .skmodel bake is mapped
+// straight into GPU buffers, otherwise a .glb next to the requested file takes
+// the native fast path, and anything else (or a glb that fails to parse) goes
+// through Assimp with an import profile matching what the asset is used for.
+// Models loaded the slow way are baked for the next run. Every load is timed
+// and its memory recorded for LoadReport().
+namespace AssetLoader
+{
+    struct LoadStats
+    {
+        std::string path;
+        const char* loader;
+        double milliseconds;
+        int64_t retainedBytes;
+        int64_t scratchBytes;
+    };
+
+    // Set from the command line (--assimp, --no-bake) to compare against the fallbacks
+    inline bool preferGlb = true;
+    inline bool useBaked = true;
+    inline std::vector<LoadStats> history;
+
+    inline std::string GetGlbPath(const std::string& path)
+    {
+        size_t dot = path.find_last_of('.');
+        return (dot == std::string::npos ? path : path.substr(0, dot)) + ".glb";
+    }
+
+    inline bool FileExists(const std::string& path)
+    {
+        return std::ifstream(path).good();
+    }
+
+    // True when `path` exists and was written after `source`
+    inline bool IsUpToDate(const std::string& path, const std::string& source)
+    {
+        std::error_code error;
+        auto built = std::filesystem::last_write_time(path, error);
+        if (error)
+            return false;
+        auto changed = std::filesystem::last_write_time(source, error);
+        return error || built >= changed;
+    }
+
+    template <typename LoadFn>
+    auto Measure(const std::string& path, MemTag tag, LoadFn load)
+    {
+        using Clock = std::chrono::steady_clock;
+        MemScope scope(tag, MemTag::ImportScratch);
+        Clock::time_point start = Clock::now();
+        const char* loader = "";
+        auto result = load(loader);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        history.push_back({ path, loader, ms, scope.GetRetainedBytes(), scope.GetScratchBytes() });
+        return result;
+    }
+
+    // The file a bake of `path` is built from: the .glb when LoadModel
+    // parses that, else `path` itself
+    inline std::string GetBakeSource(const std::string& path)
+    {
+        std::string glbPath = GetGlbPath(path);
+        return preferGlb && FileExists(glbPath) ? glbPath : path;
+    }
+
+    // The file LoadModel/LoadClip will actually parse for `path`
+    inline std::string GetLoadPath(const std::string& path, bool isModel)
+    {
+        std::string bakedPath = BakedModel::GetBakedPath(path);
+        if (isModel && useBaked && IsUpToDate(bakedPath, GetBakeSource(path)))
+            return bakedPath;
+        std::string glbPath = GetGlbPath(path);
+        if (preferGlb && FileExists(glbPath))
+            return glbPath;
+        return path;
+    }
+
+    // Reads every model and clip of a load set in one I/O batch, so the
+    // loaders below parse from memory instead of each blocking on its own
+    // reads. Call AsyncIO::ReleasePreloaded() once they are done.
+    inline void Preload(const std::vector<std::string>& models, const std::vector<std::string>& clips)
+    {
+        std::vector<std::string> paths;
+        for (const std::string& path : models)
+            paths.push_back(GetLoadPath(path, true));
+        for (const std::string& path : clips)
+            paths.push_back(GetLoadPath(path, false));
+        std::sort(paths.begin(), paths.end());
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+        AsyncIO::Preload(paths);
+    }
+
+    // CPU copies of the geometry are dropped once it is on the GPU unless
+    // keepCpuData is set (for CPU-side skinning or picking)
+    inline SkinnedModel* LoadModel(const std::string& path, ImportProfile profile = ImportProfile::SkinOnly,
+        bool keepCpuData = false)
+    {
+        return Measure(path, MemTag::Meshes, [&](const char*& loader) {
+            std::string bakedPath = BakedModel::GetBakedPath(path);
+            if (useBaked && IsUpToDate(bakedPath, GetBakeSource(path)))
+            {
+                if (SkinnedModel* model = BakedModel::Load(bakedPath))
+                {
+                    loader = "baked";
+                    return model;
+                }
+            }
+
+            SkinnedModel* model = nullptr;
+            std::string glbPath = GetGlbPath(path);
+            if (preferGlb && FileExists(glbPath))
+            {
+                model = GltfLoader::LoadModel(glbPath);
+                loader = "glb";
+            }
+            if (!model)
+            {
+                model = SkinnedModel::LoadAssimp(path, profile);
+                loader = GetProfileName(profile);
+            }
+            if (model && useBaked && !BakedModel::Save(bakedPath, *model))
+                std::cout << "BAKED: could not write " << bakedPath << std::endl;
+            if (model && !keepCpuData)
+                model->ReleaseCpuData();
+            return model;
+        });
+    }
+
+    inline AnimClip* LoadClip(const std::string& path, SkinnedModel* model)
+    {
+        return Measure(path, MemTag::Clips, [&](const char*& loader) {
+            std::string glbPath = GetGlbPath(path);
+            if (preferGlb && FileExists(glbPath))
+            {
+                if (AnimClip* clip = GltfLoader::LoadClip(glbPath, model))
+                {
+                    loader = "glb";
+                    return clip;
+                }
+            }
+            loader = GetProfileName(ImportProfile::AnimOnly);
+            return AnimClip::LoadAssimp(path, model);
+        });
+    }
+
+    inline void LoadReport()
+    {
+        double totalMs = 0.0;
+        int64_t peakScratch = 0;
+        std::printf("%-12s %10s %12s %12s  %s\n", "loader", "ms", "kept MB", "scratch MB", "asset");
+        for (const LoadStats& s : history)
+        {
+            std::printf("%-12s %10.2f %12.2f %12.2f  %s\n", s.loader, s.milliseconds,
+                s.retainedBytes / (1024.0 * 1024.0), s.scratchBytes / (1024.0 * 1024.0), s.path.c_str());
+            totalMs += s.milliseconds;
+            if (s.scratchBytes > peakScratch)
+                peakScratch = s.scratchBytes;
+        }
+        std::printf("%-12s %10.2f %12s %12.2f\n", "total", totalMs, "", peakScratch / (1024.0 * 1024.0));
+
+        // Import time per loader/profile
+        std::vector<std::pair<std::string, double>> perLoader;
+        for (const LoadStats& s : history)
+        {
+            auto it = std::find_if(perLoader.begin(), perLoader.end(),
+                [&](const std::pair<std::string, double>& p) { return p.first == s.loader; });
+            if (it == perLoader.end())
+                perLoader.push_back({ s.loader, s.milliseconds });
+            else
+                it->second += s.milliseconds;
+        }
+        for (const auto& p : perLoader)
+            std::printf("%-12s %10.2f ms\n", p.first.c_str(), p.second);
+        AsyncIO::Report();
+
+        double ioMs = 0.0;
+        for (const AsyncIO::BatchStats& s : AsyncIO::history)
+            ioMs += s.milliseconds;
+        BlobCodec::Report(ioMs);
+    }
+}
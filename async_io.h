@@ -0,0 +1,494 @@
+#pragma once
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// Batched whole-file reads. A ReadBatch collects paths, sizes them, reads
+// every file into one contiguous buffer and hands out (data, size) views that
+// the parsers take from memory (Assimp ReadFileFromMemory, stbi_load_from_memory,
+// the glb and baked readers).
+//
+// On Linux the reads go through io_uring, talking to the kernel with raw
+// syscalls (no liburing): the batch buffer is registered once so the kernel
+// does not have to map it per request, files are split into chunks that are
+// all in flight together, and one io_uring_enter both submits and waits.
+// Where io_uring is missing or refused (old kernels, seccomp in containers)
+// the same chunks are pread by the job system instead.
+namespace AsyncIO
+{
+    struct FileData
+    {
+        std::string path;
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        bool ok = false;
+    };
+
+    struct BatchStats
+    {
+        const char* backend;
+        int files;
+        int failed;
+        size_t bytes;
+        double milliseconds;
+        bool cold;
+    };
+
+    // --no-uring forces the thread fallback; --cold drops each file from the
+    // page cache before reading it, to measure a cold start without root
+    inline bool useUring = true;
+    inline bool dropCaches = false;
+    inline std::vector<BatchStats> history;
+
+    const size_t CHUNK_SIZE = 1 << 20;
+    const unsigned RING_ENTRIES = 64;
+
+#ifdef __linux__
+    // Minimal io_uring: one submission ring, one completion ring, one
+    // registered buffer. Single producer and consumer (the calling thread).
+    class Uring
+    {
+    public:
+        Uring() = default;
+        Uring(const Uring&) = delete;
+        Uring& operator=(const Uring&) = delete;
+        ~Uring() { Close(); }
+
+        bool Open(unsigned entries)
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            m_Fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+            if (m_Fd < 0)
+                return false;
+
+            m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single)
+                m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+
+            m_SqRing = mmap(nullptr, m_SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Fd, IORING_OFF_SQ_RING);
+            if (m_SqRing == MAP_FAILED)
+            {
+                m_SqRing = nullptr;
+                Close();
+                return false;
+            }
+            if (single)
+                m_CqRing = m_SqRing;
+            else
+            {
+                m_CqRing = mmap(nullptr, m_CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Fd, IORING_OFF_CQ_RING);
+                if (m_CqRing == MAP_FAILED)
+                {
+                    m_CqRing = nullptr;
+                    Close();
+                    return false;
+                }
+            }
+            m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = mmap(nullptr, m_SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Fd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED)
+            {
+                Close();
+                return false;
+            }
+            m_Sqes = (io_uring_sqe*)sqes;
+
+            char* sq = (char*)m_SqRing;
+            char* cq = (char*)m_CqRing;
+            m_SqTail = (unsigned*)(sq + params.sq_off.tail);
+            m_SqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+            m_SqArray = (unsigned*)(sq + params.sq_off.array);
+            m_CqHead = (unsigned*)(cq + params.cq_off.head);
+            m_CqTail = (unsigned*)(cq + params.cq_off.tail);
+            m_CqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+            m_Cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+            m_Entries = params.sq_entries;
+            return true;
+        }
+
+        void Close()
+        {
+            if (m_Sqes)
+                munmap(m_Sqes, m_SqesSize);
+            if (m_CqRing && m_CqRing != m_SqRing)
+                munmap(m_CqRing, m_CqRingSize);
+            if (m_SqRing)
+                munmap(m_SqRing, m_SqRingSize);
+            if (m_Fd >= 0)
+                close(m_Fd);
+            m_Sqes = nullptr;
+            m_SqRing = m_CqRing = nullptr;
+            m_Fd = -1;
+        }
+
+        // Pins the buffer for READ_FIXED; fails under a low RLIMIT_MEMLOCK,
+        // in which case plain READ is used on the same memory
+        bool RegisterBuffer(void* data, size_t size)
+        {
+            iovec buffer = { data, size };
+            m_Registered = syscall(__NR_io_uring_register, m_Fd, IORING_REGISTER_BUFFERS, &buffer, 1) == 0;
+            return m_Registered;
+        }
+
+        unsigned GetEntries() const { return m_Entries; }
+
+        void QueueRead(int fd, unsigned char* destination, unsigned length, uint64_t offset, uint64_t userData)
+        {
+            unsigned tail = *m_SqTail;
+            unsigned index = tail & m_SqMask;
+            io_uring_sqe& sqe = m_Sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = m_Registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            sqe.fd = fd;
+            sqe.addr = (uint64_t)(uintptr_t)destination;
+            sqe.len = length;
+            sqe.off = offset;
+            sqe.buf_index = 0;
+            sqe.user_data = userData;
+            m_SqArray[index] = index;
+            __atomic_store_n(m_SqTail, tail + 1, __ATOMIC_RELEASE);
+            m_Pending++;
+        }
+
+        // Submits everything queued and blocks until at least one completion.
+        // 0 or -errno; entries the kernel did not take (e.g. on -EINTR) stay
+        // queued for the next call.
+        int SubmitAndWait()
+        {
+            long result = syscall(__NR_io_uring_enter, m_Fd, m_Pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result < 0)
+                return -errno;
+            m_Pending -= std::min((unsigned)result, m_Pending);
+            return 0;
+        }
+
+        // Queued but not yet taken by the kernel
+        unsigned GetPending() const { return m_Pending; }
+
+        // Reaps `count` completions, blocking as needed. Reads the kernel
+        // has taken keep writing into their destinations until they
+        // complete, so this must run before the ring (or the buffer) is given
+        // up. Completions land in the ring memory whether or not enter
+        // works, so a failing wait falls back to polling it.
+        template <typename Fn>
+        void WaitForCompletions(unsigned count, Fn&& onCompletion)
+        {
+            while (count > 0)
+            {
+                DrainCompletions([&](uint64_t userData, int result) {
+                    count -= count > 0 ? 1 : 0;
+                    onCompletion(userData, result);
+                });
+                if (count > 0 && syscall(__NR_io_uring_enter, m_Fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                    && errno != EINTR && errno != EAGAIN)
+                    sched_yield();
+            }
+        }
+
+        template <typename Fn>
+        void DrainCompletions(Fn&& onCompletion)
+        {
+            unsigned head = *m_CqHead;
+            unsigned tail = __atomic_load_n(m_CqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head)
+            {
+                const io_uring_cqe& cqe = m_Cqes[head & m_CqMask];
+                onCompletion(cqe.user_data, cqe.res);
+            }
+            __atomic_store_n(m_CqHead, head, __ATOMIC_RELEASE);
+        }
+
+    private:
+        int m_Fd = -1;
+        void* m_SqRing = nullptr;
+        void* m_CqRing = nullptr;
+        size_t m_SqRingSize = 0;
+        size_t m_CqRingSize = 0;
+        size_t m_SqesSize = 0;
+        io_uring_sqe* m_Sqes = nullptr;
+        unsigned* m_SqTail = nullptr;
+        unsigned* m_SqArray = nullptr;
+        unsigned m_SqMask = 0;
+        unsigned* m_CqHead = nullptr;
+        unsigned* m_CqTail = nullptr;
+        unsigned m_CqMask = 0;
+        io_uring_cqe* m_Cqes = nullptr;
+        unsigned m_Entries = 0;
+        unsigned m_Pending = 0;
+        bool m_Registered = false;
+    };
+#endif
+
+    class ReadBatch
+    {
+    public:
+        ReadBatch() = default;
+        ReadBatch(const ReadBatch&) = delete;
+        ReadBatch& operator=(const ReadBatch&) = delete;
+
+        size_t Add(const std::string& path)
+        {
+            FileData file;
+            file.path = path;
+            m_Files.push_back(file);
+            return m_Files.size() - 1;
+        }
+
+        // Reads every added file; false if any of them failed
+        bool Read()
+        {
+            using Clock = std::chrono::steady_clock;
+            Clock::time_point start = Clock::now();
+            const char* backend = "none";
+#ifdef __linux__
+            std::vector<int> fds(m_Files.size(), -1);
+            std::vector<size_t> offsets(m_Files.size(), 0);
+            size_t total = 0;
+            for (size_t i = 0; i < m_Files.size(); ++i)
+            {
+                int fd = open(m_Files[i].path.c_str(), O_RDONLY | O_CLOEXEC);
+                struct stat info;
+                if (fd < 0 || fstat(fd, &info) != 0)
+                {
+                    if (fd >= 0)
+                        close(fd);
+                    continue;
+                }
+                if (dropCaches)
+                    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                fds[i] = fd;
+                offsets[i] = total;
+                m_Files[i].size = (size_t)info.st_size;
+                total += (m_Files[i].size + 63) & ~(size_t)63;
+            }
+
+            // One page-aligned block for the whole batch
+            m_Buffer.reset(new unsigned char[total + 4096]);
+            unsigned char* base = (unsigned char*)(((uintptr_t)m_Buffer.get() + 4095) & ~(uintptr_t)4095);
+            std::vector<Chunk> chunks;
+            for (size_t i = 0; i < m_Files.size(); ++i)
+            {
+                if (fds[i] < 0)
+                    continue;
+                m_Files[i].data = base + offsets[i];
+                m_Files[i].ok = true;
+                for (size_t offset = 0; offset < m_Files[i].size; offset += CHUNK_SIZE)
+                    chunks.push_back({ i, fds[i], base + offsets[i] + offset, offset, std::min(CHUNK_SIZE, m_Files[i].size - offset) });
+            }
+
+            backend = "threads";
+            if (!(useUring && ReadUring(chunks, base, total)))
+                ReadThreads(chunks);
+            else
+                backend = "io_uring";
+
+            for (int fd : fds)
+                if (fd >= 0)
+                    close(fd);
+#else
+            for (FileData& file : m_Files)
+            {
+                FILE* handle = std::fopen(file.path.c_str(), "rb");
+                if (!handle)
+                    continue;
+                std::fseek(handle, 0, SEEK_END);
+                file.size = (size_t)std::ftell(handle);
+                std::fseek(handle, 0, SEEK_SET);
+                m_Copies.emplace_back(new unsigned char[file.size + 1]);
+                file.data = m_Copies.back().get();
+                file.ok = std::fread(m_Copies.back().get(), 1, file.size, handle) == file.size;
+                std::fclose(handle);
+            }
+            backend = "stdio";
+#endif
+            int failed = 0;
+            size_t bytes = 0;
+            for (FileData& file : m_Files)
+            {
+                if (!file.ok)
+                {
+                    file.data = nullptr;
+                    file.size = 0;
+                    failed++;
+                }
+                bytes += file.size;
+            }
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            history.push_back({ backend, (int)m_Files.size(), failed, bytes, ms, dropCaches });
+            return failed == 0;
+        }
+
+        const FileData& Get(size_t index) const { return m_Files[index]; }
+        size_t GetCount() const { return m_Files.size(); }
+
+        const FileData* Find(const std::string& path) const
+        {
+            for (const FileData& file : m_Files)
+                if (file.ok && file.path == path)
+                    return &file;
+            return nullptr;
+        }
+
+    private:
+        struct Chunk
+        {
+            size_t file;
+            int fd;
+            unsigned char* destination;
+            size_t offset;
+            size_t length;
+        };
+
+#ifdef __linux__
+        // Keeps up to the ring size in flight; short reads are resubmitted
+        // for the remainder, errors fail just that file
+        bool ReadUring(std::vector<Chunk>& chunks, unsigned char* buffer, size_t size)
+        {
+            Uring ring;
+            if (!ring.Open(RING_ENTRIES))
+                return false;
+            if (size > 0)
+                ring.RegisterBuffer(buffer, size);
+
+            std::vector<size_t> queue;
+            for (size_t i = 0; i < chunks.size(); ++i)
+                queue.push_back(chunks.size() - 1 - i); // popped from the back, so in order
+            unsigned inFlight = 0;
+            auto onCompletion = [&](uint64_t index, int result) {
+                inFlight--;
+                Chunk& chunk = chunks[index];
+                if (result < 0 || (result == 0 && chunk.length > 0))
+                {
+                    // e.g. -EINVAL for READ on a kernel that only has READ_FIXED
+                    if (!PreadAll(chunk))
+                        m_Files[chunk.file].ok = false;
+                    return;
+                }
+                if ((size_t)result < chunk.length)
+                {
+                    chunk.destination += result;
+                    chunk.offset += result;
+                    chunk.length -= result;
+                    queue.push_back(index);
+                }
+            };
+            while (!queue.empty() || inFlight > 0)
+            {
+                while (!queue.empty() && inFlight < ring.GetEntries())
+                {
+                    const Chunk& chunk = chunks[queue.back()];
+                    ring.QueueRead(chunk.fd, chunk.destination, (unsigned)chunk.length, chunk.offset, queue.back());
+                    queue.pop_back();
+                    inFlight++;
+                }
+                int error = ring.SubmitAndWait();
+                // A signal during the wait, or the kernel short of memory or
+                // completion space: reap what is there and go again
+                if (error == -EINTR || error == -EAGAIN || error == -EBUSY)
+                {
+                    ring.DrainCompletions(onCompletion);
+                    continue;
+                }
+                if (error != 0)
+                {
+                    // Wait out every read the kernel took before re-reading
+                    // with threads, so none lands after the batch is released;
+                    // what is left of each chunk is then read again
+                    ring.WaitForCompletions(inFlight - ring.GetPending(), onCompletion);
+                    ReadThreads(chunks);
+                    return true;
+                }
+                ring.DrainCompletions(onCompletion);
+            }
+            return true;
+        }
+
+        static bool PreadAll(Chunk chunk)
+        {
+            while (chunk.length > 0)
+            {
+                ssize_t got = pread(chunk.fd, chunk.destination, chunk.length, (off_t)chunk.offset);
+                if (got <= 0)
+                    return false;
+                chunk.destination += got;
+                chunk.offset += got;
+                chunk.length -= got;
+            }
+            return true;
+        }
+
+        void ReadThreads(const std::vector<Chunk>& chunks)
+        {
+            std::vector<char> failed(chunks.size(), 0);
+            GetJobSystem().ParallelFor(chunks.size(), [&](size_t i) { failed[i] = !PreadAll(chunks[i]); });
+            for (size_t i = 0; i < chunks.size(); ++i)
+                if (failed[i])
+                    m_Files[chunks[i].file].ok = false;
+        }
+#else
+        std::vector<std::unique_ptr<unsigned char[]>> m_Copies;
+#endif
+
+        std::vector<FileData> m_Files;
+        std::unique_ptr<unsigned char[]> m_Buffer;
+    };
+
+    // The current load set: files read up front so loaders can parse them
+    // from memory. Main thread only.
+    inline std::vector<std::unique_ptr<ReadBatch>> loadSets;
+
+    inline void Preload(const std::vector<std::string>& paths)
+    {
+        std::unique_ptr<ReadBatch> batch(new ReadBatch());
+        for (const std::string& path : paths)
+            batch->Add(path);
+        batch->Read();
+        loadSets.push_back(std::move(batch));
+    }
+
+    inline const FileData* FindPreloaded(const std::string& path)
+    {
+        for (const std::unique_ptr<ReadBatch>& batch : loadSets)
+            if (const FileData* file = batch->Find(path))
+                return file;
+        return nullptr;
+    }
+
+    // Once the loaders are done with the raw bytes
+    inline void ReleasePreloaded()
+    {
+        loadSets.clear();
+    }
+
+    inline void Report()
+    {
+        for (const BatchStats& s : history)
+            std::printf("io %-9s %4d files (%d failed) %9.2f MB %9.2f ms %9.1f MB/s%s\n", s.backend, s.files, s.failed,
+                s.bytes / (1024.0 * 1024.0), s.milliseconds,
+                s.milliseconds > 0.0 ? s.bytes / (1024.0 * 1024.0) / (s.milliseconds / 1000.0) : 0.0,
+                s.cold ? "  (cold cache)" : "");
+    }
+}
@@ -0,0 +1,499 @@
+#pragma once
+
+#include "async_io.h"
+#include "blob_codec.h"
+#include "skeleton.h"
+#include "skinned_model.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <iostream>
+#include <new>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Baked model files (.skmodel) hold a SkinnedModel's shared vertex and index
+// buffers exactly as Upload() sends them to GL, plus the submesh, texture and
+// bone tables needed to rebuild the rest. Loading maps the file and passes the
+// blobs straight to glBufferData, so geometry is never copied into vectors.
+// With a codec set (see blob_codec.h) the two blobs are stored as compressed
+// chunks instead and decoded on the job workers into one scratch buffer.
+//
+// Layout, offsets from the start of the file:
+//   BakedHeader
+//   BakedSubMesh[subMeshCount]
+//   uint32_t textureIndices[subMeshTextureCount]  (into the texture table)
+//   BakedTexture[textureCount]
+//   BakedBone[boneCount]
+//   string pool (NUL-terminated, referenced by offset)
+//   vertices at vertexOffset, indices at indexOffset (both 16-byte aligned),
+//   either raw or, when the blob's chunk count is non-zero, packed as
+//   BlobCodec chunks taking vertexPackedSize / indexPackedSize bytes
+namespace BakedModel
+{
+    const uint32_t MAGIC = 0x4C444D53; // "SMDL"
+    const uint32_t VERSION = 2;
+
+    struct BakedHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexStride; // sizeof(Vertex) at bake time
+        uint32_t subMeshCount;
+        uint32_t subMeshTextureCount;
+        uint32_t textureCount;
+        uint32_t boneCount;
+        uint32_t stringsOffset;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint32_t codec; // what the bake asked for; single chunks may still be stored
+        uint32_t vertexChunkCount;
+        uint32_t indexChunkCount;
+        uint32_t reserved;
+        uint64_t vertexPackedSize;
+        uint64_t indexPackedSize;
+    };
+
+    // Codec for new bakes (--bake-codec). A bake made with another codec is
+    // treated as stale and rebaked, so switching settings compares like for like.
+    inline BlobCodec::Codec codec = BlobCodec::GetDefault();
+
+    struct BakedSubMesh
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        int32_t baseVertex;
+        uint32_t firstTexture;
+        uint32_t textureCount;
+    };
+
+    struct BakedTexture
+    {
+        uint32_t path;
+        uint32_t type;
+    };
+
+    struct BakedBone
+    {
+        uint32_t name;
+        int32_t id;
+        float offset[16];
+    };
+
+    inline std::string GetBakedPath(const std::string& path)
+    {
+        size_t dot = path.find_last_of('.');
+        return (dot == std::string::npos ? path : path.substr(0, dot)) + ".skmodel";
+    }
+
+    // Read-only view of a whole file, memory mapped where the platform allows
+    class MappedFile
+    {
+    public:
+        ~MappedFile() { Close(); }
+
+        bool Open(const std::string& path)
+        {
+            // Already read as part of the load set: borrow those bytes
+            if (const AsyncIO::FileData* preloaded = AsyncIO::FindPreloaded(path))
+            {
+                m_Data = preloaded->data;
+                m_Size = preloaded->size;
+                m_Borrowed = true;
+                return m_Size > 0;
+            }
+#ifndef _WIN32
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size == 0)
+            {
+                close(fd);
+                return false;
+            }
+            void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED)
+                return false;
+            // The blobs are read once, front to back, by glBufferData
+            madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+            m_Data = (const uint8_t*)data;
+            m_Size = (size_t)info.st_size;
+            return true;
+#else
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file)
+                return false;
+            m_Copy.resize((size_t)file.tellg());
+            file.seekg(0);
+            file.read((char*)m_Copy.data(), (std::streamsize)m_Copy.size());
+            m_Data = m_Copy.data();
+            m_Size = m_Copy.size();
+            return (bool)file;
+#endif
+        }
+
+        void Close()
+        {
+#ifndef _WIN32
+            if (m_Data && !m_Borrowed)
+                munmap((void*)m_Data, m_Size);
+#else
+            std::vector<uint8_t>().swap(m_Copy);
+#endif
+            m_Data = nullptr;
+            m_Size = 0;
+            m_Borrowed = false;
+        }
+
+        // Starts reading a range ahead of use: while workers decode the
+        // first chunks, the kernel is already fetching the later ones
+        void WillNeed(size_t offset, size_t size)
+        {
+#ifndef _WIN32
+            if (!m_Data || m_Borrowed || offset >= m_Size)
+                return;
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            size_t start = offset & ~(page - 1);
+            madvise((void*)(m_Data + start), std::min(m_Size, offset + size) - start, MADV_WILLNEED);
+#else
+            (void)offset;
+            (void)size;
+#endif
+        }
+
+        const uint8_t* GetData() const { return m_Data; }
+        size_t GetSize() const { return m_Size; }
+
+    private:
+        const uint8_t* m_Data = nullptr;
+        size_t m_Size = 0;
+        bool m_Borrowed = false;
+#ifdef _WIN32
+        std::vector<uint8_t> m_Copy;
+#endif
+    };
+
+    // Writes a model that still has its CPU copies (see ReleaseCpuData).
+    // Models with textures embedded in a .glb are skipped: the baked file
+    // only references texture files on disk.
+    inline bool Save(const std::string& path, const SkinnedModel& model)
+    {
+        if (!model.HasCpuData())
+            return false;
+        for (const Texture& texture : model.textures_loaded)
+            if (texture.path.compare(0, 4, "glb:") == 0)
+                return false;
+
+        std::vector<char> strings;
+        auto addString = [&](const std::string& text) {
+            uint32_t offset = (uint32_t)strings.size();
+            strings.insert(strings.end(), text.begin(), text.end());
+            strings.push_back('\0');
+            return offset;
+        };
+
+        std::vector<BakedTexture> textures;
+        for (const Texture& texture : model.textures_loaded)
+            textures.push_back({ addString(texture.path), addString(texture.type) });
+
+        std::vector<BakedSubMesh> subMeshes;
+        std::vector<uint32_t> textureIndices;
+        for (const SubMesh& mesh : model.meshes)
+        {
+            BakedSubMesh baked = { mesh.firstIndex, mesh.indexCount, mesh.baseVertex, (uint32_t)textureIndices.size(), 0 };
+            for (const Texture& texture : mesh.textures)
+            {
+                for (size_t t = 0; t < model.textures_loaded.size(); ++t)
+                {
+                    if (model.textures_loaded[t].path == texture.path)
+                    {
+                        textureIndices.push_back((uint32_t)t);
+                        baked.textureCount++;
+                        break;
+                    }
+                }
+            }
+            subMeshes.push_back(baked);
+        }
+
+        std::vector<BakedBone> bones;
+        for (const auto& entry : model.GetBoneInfoMap())
+        {
+            BakedBone bone;
+            bone.name = addString(entry.first);
+            bone.id = entry.second.id;
+            std::memcpy(bone.offset, &entry.second.offset[0][0], sizeof(bone.offset));
+            bones.push_back(bone);
+        }
+
+        const std::vector<Vertex>& vertices = model.GetVertices();
+        const std::vector<unsigned int>& indices = model.GetIndices();
+        auto align16 = [](uint64_t offset) { return (offset + 15) & ~(uint64_t)15; };
+
+        BakedHeader header = {};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.vertexStride = sizeof(Vertex);
+        header.subMeshCount = (uint32_t)subMeshes.size();
+        header.subMeshTextureCount = (uint32_t)textureIndices.size();
+        header.textureCount = (uint32_t)textures.size();
+        header.boneCount = (uint32_t)bones.size();
+        header.stringsOffset = (uint32_t)(sizeof(BakedHeader) + subMeshes.size() * sizeof(BakedSubMesh)
+            + textureIndices.size() * sizeof(uint32_t) + textures.size() * sizeof(BakedTexture) + bones.size() * sizeof(BakedBone));
+        header.vertexCount = vertices.size();
+        header.indexCount = indices.size();
+        header.codec = (uint32_t)codec;
+
+        // Raw blobs are written straight from the model's vectors
+        std::vector<uint8_t> packedVertices;
+        std::vector<uint8_t> packedIndices;
+        header.vertexPackedSize = vertices.size() * sizeof(Vertex);
+        header.indexPackedSize = indices.size() * sizeof(unsigned int);
+        if (codec != BlobCodec::Codec::Stored)
+        {
+            header.vertexChunkCount = BlobCodec::Compress(vertices.data(), (size_t)header.vertexPackedSize, codec, packedVertices);
+            header.indexChunkCount = BlobCodec::Compress(indices.data(), (size_t)header.indexPackedSize, codec, packedIndices);
+            header.vertexPackedSize = packedVertices.size();
+            header.indexPackedSize = packedIndices.size();
+        }
+        const void* vertexBlob = header.vertexChunkCount ? (const void*)packedVertices.data() : (const void*)vertices.data();
+        const void* indexBlob = header.indexChunkCount ? (const void*)packedIndices.data() : (const void*)indices.data();
+        header.vertexOffset = align16(header.stringsOffset + strings.size());
+        header.indexOffset = align16(header.vertexOffset + header.vertexPackedSize);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        static const char padding[16] = {};
+        auto pad = [&](uint64_t offset) { file.write(padding, (std::streamsize)(offset - (uint64_t)file.tellp())); };
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)subMeshes.data(), (std::streamsize)(subMeshes.size() * sizeof(BakedSubMesh)));
+        file.write((const char*)textureIndices.data(), (std::streamsize)(textureIndices.size() * sizeof(uint32_t)));
+        file.write((const char*)textures.data(), (std::streamsize)(textures.size() * sizeof(BakedTexture)));
+        file.write((const char*)bones.data(), (std::streamsize)(bones.size() * sizeof(BakedBone)));
+        file.write(strings.data(), (std::streamsize)strings.size());
+        pad(header.vertexOffset);
+        file.write((const char*)vertexBlob, (std::streamsize)header.vertexPackedSize);
+        pad(header.indexOffset);
+        file.write((const char*)indexBlob, (std::streamsize)header.indexPackedSize);
+        return (bool)file;
+    }
+
+    // offset + bytes <= limit, without wrapping
+    inline bool FitsIn(uint64_t offset, uint64_t bytes, uint64_t limit)
+    {
+        return offset <= limit && bytes <= limit - offset;
+    }
+
+    // A packed blob has exactly the chunks BlobCodec::Compress makes for its
+    // raw size, and room for their table; this bounds what decoding allocates
+    inline bool IsChunkingValid(uint32_t chunkCount, uint64_t rawBytes, uint64_t packedSize)
+    {
+        return chunkCount == (rawBytes + BlobCodec::CHUNK_SIZE - 1) / BlobCodec::CHUNK_SIZE
+            && (uint64_t)chunkCount * sizeof(BlobCodec::ChunkEntry) <= packedSize;
+    }
+
+    // Tables, string pool and blobs in the order Save writes them, all inside
+    // the file. Counts are capped at 32 bits: GL indices cannot address more.
+    inline bool IsLayoutValid(const BakedHeader& header, size_t size)
+    {
+        uint64_t tablesEnd = sizeof(BakedHeader) + (uint64_t)header.subMeshCount * sizeof(BakedSubMesh)
+            + (uint64_t)header.subMeshTextureCount * sizeof(uint32_t) + (uint64_t)header.textureCount * sizeof(BakedTexture)
+            + (uint64_t)header.boneCount * sizeof(BakedBone);
+        return tablesEnd <= header.stringsOffset && header.stringsOffset <= header.vertexOffset
+            && header.vertexOffset % 16 == 0 && header.indexOffset % 16 == 0
+            && FitsIn(header.vertexOffset, header.vertexPackedSize, header.indexOffset)
+            && FitsIn(header.indexOffset, header.indexPackedSize, size)
+            && header.vertexCount <= UINT32_MAX && header.indexCount <= UINT32_MAX
+            && (header.vertexChunkCount ? IsChunkingValid(header.vertexChunkCount, header.vertexCount * sizeof(Vertex), header.vertexPackedSize)
+                                        : header.vertexPackedSize == header.vertexCount * sizeof(Vertex))
+            && (header.indexChunkCount ? IsChunkingValid(header.indexChunkCount, header.indexCount * sizeof(unsigned int), header.indexPackedSize)
+                                       : header.indexPackedSize == header.indexCount * sizeof(unsigned int));
+    }
+
+    // String at `offset` in the pool, or null unless it is NUL-terminated inside it
+    inline const char* GetString(const char* pool, uint64_t poolSize, uint32_t offset)
+    {
+        if (offset >= poolSize || !std::memchr(pool + offset, '\0', (size_t)(poolSize - offset)))
+            return nullptr;
+        return pool + offset;
+    }
+
+    inline SkinnedModel* Load(const std::string& path)
+    {
+        MappedFile file;
+        if (!file.Open(path))
+            return nullptr;
+
+        const uint8_t* data = file.GetData();
+        size_t size = file.GetSize();
+        auto reject = [&path](const char* reason) {
+            std::cout << "BAKED: " << path << ": stale or corrupt (" << reason << "), ignoring" << std::endl;
+            return (SkinnedModel*)nullptr;
+        };
+        BakedHeader header;
+        if (size < sizeof(header))
+            return reject("truncated header");
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != MAGIC || header.version != VERSION || header.vertexStride != sizeof(Vertex))
+            return reject("format");
+        if (!IsLayoutValid(header, size))
+            return reject("layout");
+        if (header.codec != (uint32_t)codec)
+        {
+            std::cout << "BAKED: " << path << ": baked as " << BlobCodec::GetName((BlobCodec::Codec)header.codec)
+                      << ", rebaking as " << BlobCodec::GetName(codec) << std::endl;
+            return nullptr;
+        }
+
+        // Everything the tables reference is checked before any of it is used
+        const BakedSubMesh* subMeshes = (const BakedSubMesh*)(data + sizeof(BakedHeader));
+        const uint32_t* textureIndices = (const uint32_t*)(subMeshes + header.subMeshCount);
+        const BakedTexture* textures = (const BakedTexture*)(textureIndices + header.subMeshTextureCount);
+        const BakedBone* bones = (const BakedBone*)(textures + header.textureCount);
+        const char* strings = (const char*)(data + header.stringsOffset);
+        uint64_t stringsSize = header.vertexOffset - header.stringsOffset;
+
+        std::vector<std::pair<std::string, std::string>> textureFiles;
+        for (uint32_t t = 0; t < header.textureCount; ++t)
+        {
+            const char* texturePath = GetString(strings, stringsSize, textures[t].path);
+            const char* textureType = GetString(strings, stringsSize, textures[t].type);
+            if (!texturePath || !textureType)
+                return reject("texture string");
+            textureFiles.push_back({ texturePath, textureType });
+        }
+        for (uint32_t i = 0; i < header.subMeshTextureCount; ++i)
+            if (textureIndices[i] >= header.textureCount)
+                return reject("texture index");
+        for (uint32_t m = 0; m < header.subMeshCount; ++m)
+        {
+            const BakedSubMesh& mesh = subMeshes[m];
+            if (!FitsIn(mesh.firstTexture, mesh.textureCount, header.subMeshTextureCount)
+                || !FitsIn(mesh.firstIndex, mesh.indexCount, header.indexCount)
+                || mesh.baseVertex < 0 || (mesh.indexCount > 0 && (uint64_t)mesh.baseVertex >= header.vertexCount))
+                return reject("submesh range");
+        }
+        // Ids were assigned when the source was imported; added in id order
+        // below so AddBone hands the same ones out again. That only holds
+        // when the ids are exactly 0..boneCount-1 and the names are distinct,
+        // or every vertex would point at the wrong palette entry.
+        std::vector<const BakedBone*> byId(header.boneCount, nullptr);
+        std::set<std::string> boneNames;
+        for (uint32_t b = 0; b < header.boneCount; ++b)
+        {
+            const char* name = GetString(strings, stringsSize, bones[b].name);
+            if (!name || !boneNames.insert(name).second)
+                return reject("bone name");
+            if (bones[b].id < 0 || (uint32_t)bones[b].id >= header.boneCount || byId[bones[b].id])
+                return reject("bone id");
+            byId[bones[b].id] = &bones[b];
+        }
+
+        if (header.vertexChunkCount || header.indexChunkCount)
+            file.WillNeed((size_t)header.vertexOffset, (size_t)(header.indexOffset + header.indexPackedSize - header.vertexOffset));
+
+        // Raw blobs go to GL from the mapping; packed ones are decoded first
+        const uint8_t* vertices = data + header.vertexOffset;
+        const uint8_t* indices = data + header.indexOffset;
+        size_t vertexBytes = (size_t)header.vertexCount * sizeof(Vertex);
+        size_t indexBytes = (size_t)header.indexCount * sizeof(unsigned int);
+        std::unique_ptr<uint8_t[]> decoded;
+        if (header.vertexChunkCount || header.indexChunkCount)
+        {
+            // Sized from the header: a stale bake can claim more than there
+            // is memory for, and that should mean a rebake, not an abort
+            decoded.reset(new (std::nothrow) uint8_t[vertexBytes + indexBytes]);
+            if (!decoded)
+                return reject("size");
+            if (header.vertexChunkCount)
+            {
+                if (!BlobCodec::Decompress(path + " vertices", vertices, (size_t)header.vertexPackedSize,
+                        header.vertexChunkCount, decoded.get(), vertexBytes))
+                {
+                    std::cout << "BAKED: " << path << ": cannot decode vertices" << std::endl;
+                    return nullptr;
+                }
+                vertices = decoded.get();
+            }
+            if (header.indexChunkCount)
+            {
+                if (!BlobCodec::Decompress(path + " indices", indices, (size_t)header.indexPackedSize,
+                        header.indexChunkCount, decoded.get() + vertexBytes, indexBytes))
+                {
+                    std::cout << "BAKED: " << path << ": cannot decode indices" << std::endl;
+                    return nullptr;
+                }
+                indices = decoded.get() + vertexBytes;
+            }
+        }
+        else
+            BlobCodec::history.push_back({ path, BlobCodec::Codec::Stored, 0, vertexBytes + indexBytes, vertexBytes + indexBytes, 0.0 });
+
+        // Every index a submesh draws must land on a vertex, or the GPU reads
+        // past the vertex buffer
+        const unsigned int* indexData = (const unsigned int*)indices;
+        for (uint32_t m = 0; m < header.subMeshCount; ++m)
+        {
+            const BakedSubMesh& mesh = subMeshes[m];
+            uint64_t vertexLimit = header.vertexCount - (uint64_t)mesh.baseVertex;
+            for (uint32_t i = 0; i < mesh.indexCount; ++i)
+                if (indexData[mesh.firstIndex + i] >= vertexLimit)
+                    return reject("index out of range");
+        }
+        // -1 marks an unused influence; anything else must be a bone the
+        // palette (and the shader's MAX_BONES array) has
+        const Vertex* vertexData = (const Vertex*)vertices;
+        int64_t boneLimit = std::min<int64_t>(header.boneCount, MAX_BONES);
+        for (uint64_t v = 0; v < header.vertexCount; ++v)
+            for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+                if (vertexData[v].m_BoneIDs[i] != -1 && (vertexData[v].m_BoneIDs[i] < 0 || vertexData[v].m_BoneIDs[i] >= boneLimit))
+                    return reject("vertex bone id");
+
+        SkinnedModel* model = new SkinnedModel();
+        model->directory = path.substr(0, path.find_last_of("/\\"));
+
+        for (const BakedBone* bone : byId)
+        {
+            glm::mat4 offset;
+            std::memcpy(&offset[0][0], bone->offset, sizeof(bone->offset));
+            model->AddBone(strings + bone->name, offset);
+        }
+
+        model->LoadTextureFiles(textureFiles);
+
+        for (uint32_t m = 0; m < header.subMeshCount; ++m)
+        {
+            SubMesh mesh;
+            mesh.firstIndex = subMeshes[m].firstIndex;
+            mesh.indexCount = subMeshes[m].indexCount;
+            mesh.baseVertex = subMeshes[m].baseVertex;
+            for (uint32_t i = 0; i < subMeshes[m].textureCount; ++i)
+            {
+                uint32_t t = textureIndices[subMeshes[m].firstTexture + i];
+                if (model->textures_loaded[t].id)
+                    mesh.textures.push_back(model->textures_loaded[t]);
+            }
+            model->meshes.push_back(mesh);
+        }
+
+        model->UploadFromMemory(vertices, (size_t)header.vertexCount, indices, (size_t)header.indexCount);
+        return model;
+    }
+}
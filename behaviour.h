@@ -0,0 +1,340 @@
+#pragma once
+
+#include "asset_handles.h"
+#include "character_animator.h"
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Frame-scheduled coroutines for gameplay sequences. A behaviour is written
+// top to bottom and suspends on what it waits for:
+//
+//   Behaviour Jump(CharacterAnimator* animator)
+//   {
+//       animator->PlayAnimation(jumpClip);
+//       co_await ClipFinished(animator, jumpClip);
+//       co_await Seconds(0.2f);
+//       animator->PlayAnimation(idleClip);
+//   }
+//
+//   behaviours.Start(Jump(animator));
+//
+// Everything runs on the thread calling BehaviourScheduler::Update (the main
+// thread), once per frame, so behaviours may touch game state freely.
+// Coroutine frames come from BehaviourPool and the scheduler's queues keep
+// their capacity, so once the pool has grown to the peak number of live
+// behaviours, starting and resuming them allocates nothing.
+
+// Size-class free lists for coroutine frames. Blocks are carved from slabs
+// that are never returned, and only the main thread uses the pool.
+namespace BehaviourPool
+{
+    const size_t MIN_BLOCK = 64;
+    const size_t MAX_BLOCK = 4096; // larger frames fall back to the heap
+    const int CLASS_COUNT = 7;     // 64, 128, ..., 4096
+    const int BLOCKS_PER_SLAB = 64;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    inline FreeBlock* freeLists[CLASS_COUNT] = {};
+    inline std::vector<std::unique_ptr<unsigned char[]>> slabs;
+    inline int64_t liveBlocks = 0;
+    inline int64_t heapFallbacks = 0;
+
+    inline int GetClass(size_t size)
+    {
+        int sizeClass = 0;
+        for (size_t block = MIN_BLOCK; block < size; block <<= 1)
+            sizeClass++;
+        return sizeClass;
+    }
+
+    inline void* Allocate(size_t size)
+    {
+        if (size > MAX_BLOCK)
+        {
+            heapFallbacks++;
+            return ::operator new(size);
+        }
+        int sizeClass = GetClass(size);
+        if (!freeLists[sizeClass])
+        {
+            size_t blockSize = MIN_BLOCK << sizeClass;
+            MemScope scope(MemTag::Characters);
+            slabs.emplace_back(new unsigned char[blockSize * BLOCKS_PER_SLAB]);
+            unsigned char* slab = slabs.back().get();
+            for (int i = BLOCKS_PER_SLAB - 1; i >= 0; --i)
+            {
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + i * blockSize);
+                block->next = freeLists[sizeClass];
+                freeLists[sizeClass] = block;
+            }
+        }
+        FreeBlock* block = freeLists[sizeClass];
+        freeLists[sizeClass] = block->next;
+        liveBlocks++;
+        return block;
+    }
+
+    inline void Free(void* pointer, size_t size)
+    {
+        if (size > MAX_BLOCK)
+        {
+            ::operator delete(pointer);
+            return;
+        }
+        int sizeClass = GetClass(size);
+        FreeBlock* block = static_cast<FreeBlock*>(pointer);
+        block->next = freeLists[sizeClass];
+        freeLists[sizeClass] = block;
+        liveBlocks--;
+    }
+}
+
+class BehaviourScheduler;
+
+// Return type of a behaviour coroutine. It starts suspended and does nothing
+// until handed to BehaviourScheduler::Start, which then owns it.
+class Behaviour
+{
+public:
+    struct promise_type
+    {
+        BehaviourScheduler* scheduler = nullptr;
+
+        Behaviour get_return_object() { return Behaviour(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        // The scheduler destroys finished frames after resume() returns
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return BehaviourPool::Allocate(size); }
+        static void operator delete(void* pointer, size_t size) { BehaviourPool::Free(pointer, size); }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Behaviour(Behaviour&& other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+    Behaviour(const Behaviour&) = delete;
+    Behaviour& operator=(const Behaviour&) = delete;
+    Behaviour& operator=(Behaviour&&) = delete;
+
+    // Only a behaviour that was never started still owns its frame
+    ~Behaviour()
+    {
+        if (m_Handle)
+            m_Handle.destroy();
+    }
+
+    Handle Release() { return std::exchange(m_Handle, nullptr); }
+
+private:
+    explicit Behaviour(Handle handle) : m_Handle(handle) {}
+
+    Handle m_Handle;
+};
+
+class BehaviourScheduler
+{
+public:
+    struct Stats
+    {
+        int resumed = 0;     // last Update
+        double resumeMs = 0.0;
+    };
+
+    explicit BehaviourScheduler(size_t expected = 256)
+    {
+        m_NextFrame.reserve(expected);
+        m_Resuming.reserve(expected);
+        m_Timers.reserve(expected);
+        m_ClipWaits.reserve(expected);
+    }
+
+    ~BehaviourScheduler() { StopAll(); }
+
+    BehaviourScheduler(const BehaviourScheduler&) = delete;
+    BehaviourScheduler& operator=(const BehaviourScheduler&) = delete;
+
+    // Runs the behaviour up to its first co_await, right away
+    void Start(Behaviour behaviour)
+    {
+        Behaviour::Handle handle = behaviour.Release();
+        if (!handle)
+            return;
+        handle.promise().scheduler = this;
+        m_Live++;
+        Resume(handle);
+    }
+
+    // Resumes everything whose wait is over. Waits are collected before any
+    // behaviour runs, so one that suspends again (even on Seconds(0)) is
+    // resumed next frame at the earliest.
+    void Update(double now)
+    {
+        using Clock = std::chrono::steady_clock;
+        m_Now = now;
+        m_Resuming.swap(m_NextFrame);
+        while (!m_Timers.empty() && m_Timers.front().wakeTime <= now)
+        {
+            std::pop_heap(m_Timers.begin(), m_Timers.end(), LaterTimer);
+            m_Resuming.push_back(m_Timers.back().handle);
+            m_Timers.pop_back();
+        }
+        size_t kept = 0;
+        for (const ClipWait& wait : m_ClipWaits)
+        {
+            if (wait.animator->GetClipHandle() == wait.clip && wait.animator->GetLoopCount() == wait.loops)
+                m_ClipWaits[kept++] = wait;
+            else
+                m_Resuming.push_back(wait.handle);
+        }
+        m_ClipWaits.resize(kept);
+
+        Clock::time_point start = Clock::now();
+        for (std::coroutine_handle<> handle : m_Resuming)
+            Resume(handle);
+        m_Stats.resumed = (int)m_Resuming.size();
+        m_Stats.resumeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        m_TotalResumed += m_Stats.resumed;
+        m_TotalResumeMs += m_Stats.resumeMs;
+        m_Resuming.clear();
+    }
+
+    // Destroys every suspended behaviour without resuming it
+    void StopAll()
+    {
+        for (std::coroutine_handle<> handle : m_NextFrame)
+            handle.destroy();
+        for (const Timer& timer : m_Timers)
+            timer.handle.destroy();
+        for (const ClipWait& wait : m_ClipWaits)
+            wait.handle.destroy();
+        m_NextFrame.clear();
+        m_Timers.clear();
+        m_ClipWaits.clear();
+        m_Live = 0;
+    }
+
+    double GetTime() const { return m_Now; }
+    int GetLiveCount() const { return m_Live; }
+    const Stats& GetStats() const { return m_Stats; }
+
+    void Report() const
+    {
+        std::printf("behaviours: %d live, %d resumed last frame in %.3f ms, %.1f ns per resume over %lld resumes, "
+            "%lld pooled frames in %zu slabs, %lld heap frames\n",
+            m_Live, m_Stats.resumed, m_Stats.resumeMs,
+            m_TotalResumed ? m_TotalResumeMs * 1e6 / m_TotalResumed : 0.0, (long long)m_TotalResumed,
+            (long long)BehaviourPool::liveBlocks, BehaviourPool::slabs.size(), (long long)BehaviourPool::heapFallbacks);
+    }
+
+private:
+    friend struct NextFrameAwaiter;
+    friend struct SecondsAwaiter;
+    friend struct ClipFinishedAwaiter;
+
+    struct Timer
+    {
+        double wakeTime;
+        uint64_t order; // FIFO among equal wake times
+        std::coroutine_handle<> handle;
+    };
+
+    struct ClipWait
+    {
+        const CharacterAnimator* animator;
+        ClipHandle clip;
+        int loops;
+        std::coroutine_handle<> handle;
+    };
+
+    static bool LaterTimer(const Timer& a, const Timer& b)
+    {
+        return a.wakeTime > b.wakeTime || (a.wakeTime == b.wakeTime && a.order > b.order);
+    }
+
+    void Resume(std::coroutine_handle<> handle)
+    {
+        handle.resume();
+        if (handle.done())
+        {
+            handle.destroy();
+            m_Live--;
+        }
+    }
+
+    void WaitNextFrame(std::coroutine_handle<> handle) { m_NextFrame.push_back(handle); }
+
+    void WaitUntil(double wakeTime, std::coroutine_handle<> handle)
+    {
+        m_Timers.push_back({ wakeTime, m_TimerOrder++, handle });
+        std::push_heap(m_Timers.begin(), m_Timers.end(), LaterTimer);
+    }
+
+    void WaitClip(const CharacterAnimator* animator, ClipHandle clip, std::coroutine_handle<> handle)
+    {
+        m_ClipWaits.push_back({ animator, clip, animator->GetLoopCount(), handle });
+    }
+
+    double m_Now = 0.0;
+    int m_Live = 0;
+    std::vector<std::coroutine_handle<>> m_NextFrame;
+    std::vector<std::coroutine_handle<>> m_Resuming;
+    std::vector<Timer> m_Timers; // min-heap on wakeTime
+    uint64_t m_TimerOrder = 0;
+    std::vector<ClipWait> m_ClipWaits;
+
+    Stats m_Stats;
+    int64_t m_TotalResumed = 0;
+    double m_TotalResumeMs = 0.0;
+};
+
+struct NextFrameAwaiter
+{
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(Behaviour::Handle handle) { handle.promise().scheduler->WaitNextFrame(handle); }
+    void await_resume() const noexcept {}
+};
+
+struct SecondsAwaiter
+{
+    float seconds;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(Behaviour::Handle handle)
+    {
+        BehaviourScheduler* scheduler = handle.promise().scheduler;
+        scheduler->WaitUntil(scheduler->GetTime() + seconds, handle);
+    }
+    void await_resume() const noexcept {}
+};
+
+// Done when the clip reaches its end, or right away if the animator plays
+// something else by then (another behaviour or input switched it)
+struct ClipFinishedAwaiter
+{
+    const CharacterAnimator* animator;
+    ClipHandle clip;
+
+    bool await_ready() const noexcept { return animator->GetClipHandle() != clip; }
+    void await_suspend(Behaviour::Handle handle) { handle.promise().scheduler->WaitClip(animator, clip, handle); }
+    void await_resume() const noexcept {}
+};
+
+inline NextFrameAwaiter NextFrame() { return {}; }
+inline SecondsAwaiter Seconds(float seconds) { return { seconds }; }
+inline ClipFinishedAwaiter ClipFinished(const CharacterAnimator* animator, ClipHandle clip) { return { animator, clip }; }
@@ -0,0 +1,803 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/filesystem.h>
+
+#include "anim_scheduler.h"
+#include "anim_graph.h"
+#include "asset_loader.h"
+#include "behaviour.h"
+#include "character_animator.h"
+#include "clip_mirror.h"
+#include "cpu_topology.h"
+#include "frame_profiler.h"
+#include "huge_pages.h"
+#include "job_system.h"
+#include "json.h"
+#include "palette_slab.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Headless benchmark driver: `--bench` runs the animation pipeline from
+// main() (advance, schedule, sample, hierarchy, skinning) without a window,
+// repeats each scenario after warmup runs, and reports every metric as a mean
+// with a 95% confidence interval. Against a stored baseline a metric fails
+// only when it is slower by more than the threshold AND the two intervals do
+// not overlap, so noise alone does not fail the run.
+//
+// The benchmark thread is pinned (to --cpu, else the main thread's topology
+// slot) so runs do not migrate between cores halfway through. --scaling also
+// runs the crowd on 1..N job threads with and without pinning.
+// --determinism instead checks that every crowd scenario's palettes are bitwise
+// identical on any number of threads and fails otherwise. --behaviours
+// measures the cost of resuming N coroutine behaviours (behaviour.h) per
+// frame and fails if the steady state allocates. --mirror compares the right
+// turn authored, mirrored while sampling and baked mirrored (clip_mirror.h)
+// for memory and evaluation cost, and fails if the two mirrored poses drift
+// apart. --palettes writes a crowd's palettes from 1..N threads into
+// per-character heap vectors and into a PaletteSlab, to show what false
+// sharing costs. --tlb runs a large crowd with hardware counters and reports
+// dTLB misses per frame; run it with and without --huge-pages for the before
+// and after.
+//
+//   --bench [--runs=N] [--warmup=N] [--threshold=PCT] [--cpu=N] [--scaling]
+//           [--determinism] [--behaviours[=N]] [--mirror] [--palettes] [--tlb]
+//           [--baseline=FILE] [--save-baseline=FILE]
+//
+// Returns 0 when nothing regressed, 1 on a regression or a failed check, 2 on
+// setup errors.
+namespace Bench
+{
+    struct Options
+    {
+        int runs = 10;
+        int warmup = 2;
+        double threshold = 5.0; // percent
+        int cpu = -1;           // -1: topology slot 0
+        bool scaling = false;
+        bool determinism = false;
+        int behaviours = 0;
+        bool mirror = false;
+        bool palettes = false;
+        bool tlb = false;
+        std::string baselinePath;
+        std::string saveBaselinePath;
+    };
+
+    struct Scenario
+    {
+        const char* name;
+        int characters;
+        int frames;
+        bool graph = false;  // drive the crowd from BuildCrowdGraph instead of single clips
+        bool varied = false; // per-character rate, phase and time warp on the clips
+    };
+
+    // One metric over all runs of a scenario
+    struct Summary
+    {
+        std::string name;
+        double mean = 0.0;
+        double stddev = 0.0;
+        double ci95 = 0.0; // half-width
+        int runs = 0;
+    };
+
+    // Two-sided 95% Student t critical values for 1..30 degrees of freedom
+    inline double GetTCritical(int degrees)
+    {
+        static const double table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+        if (degrees < 1)
+            return 0.0;
+        return degrees <= 30 ? table[degrees - 1] : 1.96;
+    }
+
+    inline Summary Summarize(const std::string& name, const std::vector<double>& samples)
+    {
+        Summary summary;
+        summary.name = name;
+        summary.runs = (int)samples.size();
+        if (samples.empty())
+            return summary;
+        for (double sample : samples)
+            summary.mean += sample;
+        summary.mean /= samples.size();
+        if (samples.size() > 1)
+        {
+            double sum = 0.0;
+            for (double sample : samples)
+                sum += (sample - summary.mean) * (sample - summary.mean);
+            summary.stddev = std::sqrt(sum / (samples.size() - 1));
+            summary.ci95 = GetTCritical((int)samples.size() - 1) * summary.stddev / std::sqrt((double)samples.size());
+        }
+        return summary;
+    }
+
+    // options.warmup untimed calls of run(), then options.runs samples; run
+    // returns one sample in whatever unit the mode reports
+    template <typename Fn>
+    inline Summary TimeRuns(const std::string& name, const Options& options, Fn&& run)
+    {
+        for (int i = 0; i < options.warmup; ++i)
+            run();
+        std::vector<double> samples;
+        for (int i = 0; i < options.runs; ++i)
+            samples.push_back(run());
+        return Summarize(name, samples);
+    }
+
+    // 1, 2, 4 .. N job threads, N = usable CPUs
+    inline std::vector<unsigned> GetThreadCounts()
+    {
+        unsigned cpus = (unsigned)CpuTopology::Get().cpus.size();
+        std::vector<unsigned> threadCounts;
+        for (unsigned threads = 1; threads < cpus; threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(cpus);
+        return threadCounts;
+    }
+
+    // Two columns side by side for each of GetThreadCounts(), each with its
+    // speedup over one thread; measure(threads, column) times one cell
+    template <typename Fn>
+    inline void PrintScaling(const char* first, const char* second, int decimals, Fn&& measure)
+    {
+        std::printf("%7s %18s %8s %18s %8s\n", "threads", first, "speedup", second, "speedup");
+        double single[2] = {};
+        for (unsigned threads : GetThreadCounts())
+        {
+            Summary summaries[2] = { measure(threads, 0), measure(threads, 1) };
+            if (threads == 1)
+                for (int column = 0; column < 2; ++column)
+                    single[column] = summaries[column].mean;
+            std::printf("%7u %10.*f +-%6.*f %7.2fx %10.*f +-%6.*f %7.2fx\n", threads,
+                decimals, summaries[0].mean, decimals, summaries[0].ci95, single[0] / summaries[0].mean,
+                decimals, summaries[1].mean, decimals, summaries[1].ci95, single[1] / summaries[1].mean);
+        }
+    }
+
+    inline Options ParseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            if (std::strncmp(arg, "--runs=", 7) == 0)
+                options.runs = std::max(2, std::atoi(arg + 7));
+            else if (std::strncmp(arg, "--warmup=", 9) == 0)
+                options.warmup = std::max(0, std::atoi(arg + 9));
+            else if (std::strncmp(arg, "--threshold=", 12) == 0)
+                options.threshold = std::atof(arg + 12);
+            else if (std::strncmp(arg, "--cpu=", 6) == 0)
+                options.cpu = std::atoi(arg + 6);
+            else if (std::strcmp(arg, "--scaling") == 0)
+                options.scaling = true;
+            else if (std::strcmp(arg, "--determinism") == 0)
+                options.determinism = true;
+            else if (std::strcmp(arg, "--behaviours") == 0)
+                options.behaviours = 10000;
+            else if (std::strncmp(arg, "--behaviours=", 13) == 0)
+                options.behaviours = std::max(1, std::atoi(arg + 13));
+            else if (std::strcmp(arg, "--mirror") == 0)
+                options.mirror = true;
+            else if (std::strcmp(arg, "--palettes") == 0)
+                options.palettes = true;
+            else if (std::strcmp(arg, "--tlb") == 0)
+                options.tlb = true;
+            else if (std::strncmp(arg, "--baseline=", 11) == 0)
+                options.baselinePath = arg + 11;
+            else if (std::strncmp(arg, "--save-baseline=", 16) == 0)
+                options.saveBaselinePath = arg + 16;
+        }
+        return options;
+    }
+
+    // The clips main() plays, registered on a model with no GL state. Every
+    // animated node becomes a bone, which is what the skinned model gives too.
+    struct Assets
+    {
+        SkinnedModel model;
+        std::vector<AnimClip*> clips;
+        Skeleton* skeleton = nullptr;
+
+        ~Assets()
+        {
+            delete skeleton;
+            for (AnimClip* clip : clips)
+                delete clip;
+        }
+    };
+
+    inline bool LoadAssets(Assets& assets)
+    {
+        const char* files[] = { "Idle.dae", "Walking.dae", "Left Turn.dae", "Right Turn.dae", "Forward Jump.dae", "Rumba Dancing.dae" };
+        for (const char* file : files)
+        {
+            AnimClip* clip = AssetLoader::LoadClip(FileSystem::getPath(std::string("resources/objects/human/") + file), &assets.model);
+            if (!clip)
+                return false;
+            assets.clips.push_back(clip);
+        }
+        assets.skeleton = new Skeleton(assets.clips[0], &assets.model);
+        for (AnimClip* clip : assets.clips)
+            assets.skeleton->BindClip(clip);
+        return true;
+    }
+
+    struct CrowdGraph
+    {
+        AnimGraph* graph = nullptr;
+        uint16_t clock = 0;
+        uint16_t target = 0;
+    };
+
+    // Shared idle/walk blend that every character reads, a per-character
+    // dance on the upper body, and the right arm reaching for a
+    // per-character target
+    inline CrowdGraph BuildCrowdGraph(Assets& assets)
+    {
+        AnimGraphBuilder builder;
+        uint16_t sharedClock = builder.AddClock(true);
+        uint16_t locomotion = builder.AddParameter(0.5f, true);
+        uint16_t one = builder.AddParameter(1.0f, true);
+        CrowdGraph crowd;
+        crowd.clock = builder.AddClock();
+        crowd.target = builder.AddVectorParameter(glm::vec3(0.0f, 150.0f, 40.0f));
+
+        AnimGraphBuilder::Node base = builder.Blend(builder.Sample(assets.clips[0], sharedClock),
+            builder.Sample(assets.clips[1], sharedClock), locomotion);
+        AnimGraphBuilder::Node upper = builder.Mask(base, builder.Sample(assets.clips[5], crowd.clock), "mixamorig:Spine", one);
+        AnimGraphBuilder::Node output = builder.TwoBoneIK(upper, "mixamorig:RightArm", "mixamorig:RightForeArm",
+            "mixamorig:RightHand", crowd.target, one);
+        crowd.graph = builder.Compile(output, assets.skeleton);
+        return crowd;
+    }
+
+    // FNV-1a over the raw bytes of a palette: any bit that differs shows up
+    inline uint64_t HashPalette(std::span<const glm::mat4> palette, uint64_t hash = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(palette.data());
+        for (size_t i = 0; i < palette.size() * sizeof(glm::mat4); ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    // One run: a grid of characters in front of the camera, each on its own
+    // clip and phase, switching clips every two seconds like the input demo.
+    // Returns per-frame milliseconds for the whole update and each stage.
+    // With frameHashes, every frame's palettes are hashed (outside the timed
+    // part) in character order through an ordered reduction.
+    inline std::vector<double> RunScenario(const Scenario& scenario, Assets& assets, JobSystem* jobs = nullptr,
+        std::vector<uint64_t>* frameHashes = nullptr)
+    {
+        const float dt = 1.0f / 60.0f;
+        std::vector<CharacterAnimator*> animators;
+        std::vector<glm::vec3> positions(scenario.characters);
+        AnimationScheduler scheduler;
+        scheduler.budgetMs = 1.0e6f; // measure the full workload, not the budget
+        scheduler.jobs = jobs;
+        CrowdGraph crowd;
+        if (scenario.graph)
+        {
+            crowd = BuildCrowdGraph(assets);
+            if (!crowd.graph)
+                return std::vector<double>(1 + FrameProfiler::STAGE_COUNT, 0.0);
+        }
+        // Holds the first half of each cycle a little longer
+        TimeWarp warp({ glm::vec2(0.5f, 0.4f) });
+        int side = (int)std::ceil(std::sqrt((double)scenario.characters));
+        for (int i = 0; i < scenario.characters; ++i)
+        {
+            positions[i] = glm::vec3((i % side - side / 2) * 1.5f, 0.0f, -(float)(i / side) * 1.5f);
+            CharacterAnimator* animator = new CharacterAnimator(assets.skeleton, assets.clips[i % assets.clips.size()]);
+            if (crowd.graph)
+            {
+                animator->PlayGraph(crowd.graph);
+                animator->SetParameter(crowd.target, glm::vec3(20.0f * std::sin(i * 0.7f), 140.0f + 10.0f * std::cos(i * 1.3f), 40.0f));
+            }
+            if (scenario.varied)
+            {
+                animator->SetRate(0.8f + 0.4f * std::fmod(i * 0.754877f, 1.0f));
+                animator->SetPhase(i * 0.618034f);
+                if (i % 4 == 0)
+                    animator->SetTimeWarp(&warp);
+            }
+            animator->AdvanceTime(i * 0.137f);
+            animators.push_back(animator);
+            scheduler.Add(animator, &positions[i]);
+        }
+
+        glm::vec3 camera(0.0f, 2.0f, 6.0f);
+        glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 1000.0f / 700.0f, 0.1f, 100.0f)
+            * glm::lookAt(camera, glm::vec3(0.0f, 0.0f, -(float)side * 0.75f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        JobSystem serialJobs(0);
+        FrameProfiler::Reset();
+        double totalMs = 0.0;
+        for (int frame = 0; frame < scenario.frames; ++frame)
+        {
+            if (frame % 120 == 119 && !crowd.graph)
+                for (size_t i = 0; i < animators.size(); ++i)
+                    animators[i]->PlayAnimation(assets.clips[(i + frame / 120) % assets.clips.size()]);
+
+            auto start = std::chrono::steady_clock::now();
+            if (crowd.graph)
+                crowd.graph->BeginFrame(dt);
+            scheduler.Update(dt, camera, viewProjection);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            totalMs += ms;
+            FrameProfiler::EndFrame(ms);
+
+            if (frameHashes)
+            {
+                auto hashRange = [&animators](size_t begin, size_t end) {
+                    uint64_t hash = 14695981039346656037ull;
+                    for (size_t i = begin; i < end; ++i)
+                        hash = HashPalette(animators[i]->GetFinalBoneMatrices(), hash);
+                    return hash;
+                };
+                auto combine = [](uint64_t a, uint64_t b) { return (a ^ b) * 1099511628211ull; };
+                JobSystem& reducer = jobs ? *jobs : serialJobs;
+                frameHashes->push_back(reducer.ParallelReduce(animators.size(), 16, (uint64_t)0, hashRange, combine));
+            }
+        }
+
+        std::vector<double> metrics;
+        metrics.push_back(totalMs / scenario.frames);
+        for (int s = 0; s < FrameProfiler::STAGE_COUNT; ++s)
+            metrics.push_back(FrameProfiler::GetAverageMs(s));
+
+        for (CharacterAnimator* animator : animators)
+            delete animator;
+        delete crowd.graph;
+        return metrics;
+    }
+
+    // Crowd frame time on 1, 2, 4 .. N threads (N = usable CPUs), with the
+    // main thread and workers pinned to their topology slots and unpinned
+    inline void RunScaling(const Scenario& scenario, Assets& assets, const Options& options)
+    {
+        std::printf("\n%s scaling (ms/frame, mean +-95%%)\n", scenario.name);
+        PrintScaling("unpinned", "pinned", 4, [&](unsigned threads, int pin) {
+            JobSystem jobs(threads - 1, pin != 0);
+            CpuTopology::PlaceCurrentThread(0, pin != 0);
+            return TimeRuns("frame", options, [&] { return RunScenario(scenario, assets, &jobs)[0]; });
+        });
+    }
+
+    // Runs a scenario on 1, 2, 3, 4 .. max(N, 8) threads (oversubscribed past
+    // the CPU count on purpose) and compares the per-frame palette hashes with
+    // the single-threaded run. Returns false at the first frame that differs.
+    inline bool RunDeterminism(const Scenario& scenario, Assets& assets)
+    {
+        unsigned maxThreads = std::max(8u, (unsigned)CpuTopology::Get().cpus.size());
+        std::vector<unsigned> threadCounts = { 1, 2, 3 };
+        for (unsigned threads = 4; threads <= maxThreads; threads *= 2)
+            threadCounts.push_back(threads);
+
+        std::vector<uint64_t> reference;
+        bool identical = true;
+        for (unsigned threads : threadCounts)
+        {
+            JobSystem jobs(threads - 1);
+            std::vector<uint64_t> hashes;
+            RunScenario(scenario, assets, &jobs, &hashes);
+            if (hashes.empty())
+            {
+                std::printf("determinism: %-8s %2u threads  no frames ran, nothing to compare\n", scenario.name, threads);
+                return false;
+            }
+            if (reference.empty())
+                reference = hashes;
+
+            size_t frame = 0;
+            while (frame < hashes.size() && hashes[frame] == reference[frame])
+                frame++;
+            if (frame == hashes.size())
+                std::printf("determinism: %-8s %2u threads  %016llx  identical over %d frames\n", scenario.name, threads,
+                    (unsigned long long)hashes.back(), (int)hashes.size());
+            else
+            {
+                std::printf("determinism: %-8s %2u threads  palettes differ from 1 thread at frame %d (%016llx vs %016llx)\n",
+                    scenario.name, threads, (int)frame, (unsigned long long)hashes[frame], (unsigned long long)reference[frame]);
+                identical = false;
+            }
+        }
+        return identical;
+    }
+
+    inline bool ReadJson(const std::string& path, JsonValue& out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string text = buffer.str();
+        bool ok = false;
+        out = JsonValue::Parse(text.c_str(), text.size(), &ok);
+        return ok;
+    }
+
+    // Timers of different lengths and frame waits, so every frame resumes a
+    // mix of both
+    inline Behaviour BenchBehaviour(float delay, int64_t* steps)
+    {
+        for (;;)
+        {
+            co_await Seconds(delay);
+            co_await NextFrame();
+            co_await NextFrame();
+            ++*steps;
+        }
+    }
+
+    inline int64_t GetAllocationCount()
+    {
+        int64_t count = 0;
+        for (const MemCounter& counter : MemoryStats::cpu)
+            count += counter.allocations.load();
+        return count;
+    }
+
+    inline bool RunBehaviours(const Options& options)
+    {
+        const int frames = 600;
+        const int warmupFrames = 60;
+        int run = 0;
+        int64_t steadyAllocations = 0;
+        Summary summary = TimeRuns("resume", options, [&] {
+            BehaviourScheduler scheduler((size_t)options.behaviours);
+            int64_t steps = 0;
+            for (int i = 0; i < options.behaviours; ++i)
+                scheduler.Start(BenchBehaviour(0.01f * (i % 17), &steps));
+
+            double resumeMs = 0.0;
+            int64_t resumed = 0;
+            int64_t allocationsBefore = 0;
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                if (frame == warmupFrames)
+                    allocationsBefore = GetAllocationCount();
+                scheduler.Update(frame / 60.0);
+                if (frame >= warmupFrames)
+                {
+                    resumeMs += scheduler.GetStats().resumeMs;
+                    resumed += scheduler.GetStats().resumed;
+                }
+            }
+            if (run++ >= options.warmup)
+                steadyAllocations += GetAllocationCount() - allocationsBefore;
+            return resumed ? resumeMs * 1e6 / resumed : 0.0;
+        });
+
+        std::printf("behaviours: %d live, %.1f +- %.1f ns per resume, %lld allocations after warmup, "
+            "%zu pool slabs, %lld heap frames\n",
+            options.behaviours, summary.mean, summary.ci95, (long long)steadyAllocations,
+            BehaviourPool::slabs.size(), (long long)BehaviourPool::heapFallbacks);
+        if (steadyAllocations)
+            std::printf("behaviours: FAILED, resuming should not allocate once every behaviour is running\n");
+        return steadyAllocations == 0;
+    }
+
+    // Of the pose's size (farthest joint from the model origin): the baked
+    // clip interpolates mirrored keys, not mirrored poses, so it only matches
+    // the sampled mirror exactly on the keys
+    const float MIRROR_TOLERANCE = 0.01f;
+
+    // The right turn three ways: the authored clip, the left turn mirrored
+    // while sampling, and the left turn baked mirrored. Reports the memory
+    // each needs beyond the left turn and the cost of one Evaluate, and how
+    // far apart the joints of each pair of poses end up. Fails when the
+    // sampled and baked mirrors differ by more than MIRROR_TOLERANCE of the
+    // pose's size; the authored clip is only reported, as nothing makes it
+    // an exact mirror of the left turn.
+    inline bool RunMirror(Assets& assets, const Options& options)
+    {
+        const int evaluations = 2000;
+        const float dt = 1.0f / 60.0f;
+        AnimClip* leftTurn = assets.clips[2];
+        AnimClip* rightTurn = assets.clips[3];
+        ClipMirror mirror(assets.skeleton);
+        AnimClip* baked = mirror.Bake(leftTurn);
+
+        struct Mode
+        {
+            const char* name;
+            size_t bytes;
+            CharacterAnimator animator;
+        };
+        Mode modes[] = {
+            { "authored", rightTurn->GetKeyframeBytes(), CharacterAnimator(assets.skeleton, rightTurn) },
+            { "sampled", mirror.GetMemoryBytes(), CharacterAnimator(assets.skeleton, (AnimClip*)nullptr) },
+            { "baked", baked->GetKeyframeBytes(), CharacterAnimator(assets.skeleton, baked) },
+        };
+        modes[1].animator.PlayAnimation(leftTurn, &mirror);
+
+        std::printf("mirror: %d of %zu nodes paired, left turn %.1f KB\n", mirror.GetPairedCount(),
+            assets.skeleton->GetNodes().size(), leftTurn->GetKeyframeBytes() / 1024.0);
+        std::printf("%-10s %12s %16s\n", "right turn", "extra KB", "us/evaluate");
+        for (Mode& mode : modes)
+        {
+            Summary summary = TimeRuns(mode.name, options, [&] {
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < evaluations; ++i)
+                    mode.animator.UpdateAnimation(dt);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                return ms * 1000.0 / evaluations;
+            });
+            std::printf("%-10s %12.1f %9.3f +-%5.3f\n", mode.name, mode.bytes / 1024.0, summary.mean, summary.ci95);
+        }
+
+        // Same playhead on all three, then compare model-space joint positions
+        float maxBaked = 0.0f;
+        float maxAuthored = 0.0f;
+        float size = 0.0f;
+        for (int step = 0; step < 60; ++step)
+        {
+            for (Mode& mode : modes)
+            {
+                mode.animator.PlayAnimation(mode.animator.GetCurrentAnimation(), mode.animator.GetMirror());
+                mode.animator.UpdateAnimation(step * 0.05f);
+            }
+            const std::vector<glm::mat4>& sampled = modes[1].animator.GetGlobalTransforms();
+            for (size_t i = 0; i < sampled.size(); ++i)
+            {
+                glm::vec3 position(sampled[i][3]);
+                size = std::max(size, glm::length(position));
+                maxAuthored = std::max(maxAuthored, glm::length(glm::vec3(modes[0].animator.GetGlobalTransforms()[i][3]) - position));
+                maxBaked = std::max(maxBaked, glm::length(glm::vec3(modes[2].animator.GetGlobalTransforms()[i][3]) - position));
+            }
+        }
+        std::printf("mirror: joints within %.4f of each other sampled vs baked, %.4f mirrored vs authored\n",
+            maxBaked, maxAuthored);
+        delete baked;
+        if (maxBaked > MIRROR_TOLERANCE * size)
+        {
+            std::printf("mirror: FAILED, sampled and baked mirrors are %.4f apart, over %.1f%% of the pose's %.4f\n",
+                maxBaked, MIRROR_TOLERANCE * 100.0f, size);
+            return false;
+        }
+        return true;
+    }
+
+    // The skinning stage's writes alone: every pass, job workers fill the
+    // palettes of 1024 characters in dynamic order, so neighbouring
+    // characters are written by different threads. Heap vectors start wherever
+    // malloc put them and share cache lines at their ends; slab palettes are
+    // padded apart. Reports ns per palette and the speedup over one thread.
+    inline void RunPaletteScaling(Assets& assets, const Options& options)
+    {
+        const int characters = 1024;
+        const int passes = 20;
+        size_t bones = (size_t)assets.skeleton->GetPaletteSize();
+        std::vector<glm::mat4> globals(bones);
+        std::vector<glm::mat4> offsets(bones);
+        for (size_t b = 0; b < bones; ++b)
+        {
+            globals[b] = glm::translate(glm::mat4(1.0f), glm::vec3((float)b, 1.0f, 2.0f));
+            offsets[b] = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f + b * 0.01f));
+        }
+
+        std::vector<std::vector<glm::mat4>> heapPalettes;
+        for (int c = 0; c < characters; ++c)
+            heapPalettes.emplace_back(bones);
+        PaletteSlab slab;
+        std::vector<glm::mat4*> slabPalettes;
+        for (int c = 0; c < characters; ++c)
+            slabPalettes.push_back(slab.Allocate(bones));
+        size_t sharedEnds = 0;
+        for (const std::vector<glm::mat4>& palette : heapPalettes)
+            sharedEnds += ((uintptr_t)palette.data() % 64 != 0) + ((uintptr_t)(palette.data() + bones) % 64 != 0);
+
+        std::printf("palettes: %d characters x %zu bones, %zu of %d heap palette ends off a cache line, slab %.1f KB\n",
+            characters, bones, sharedEnds, characters * 2, slab.GetUsedBytes() / 1024.0);
+        PrintScaling("heap ns/palette", "slab ns/palette", 1, [&](unsigned threads, int layout) {
+            JobSystem jobs(threads - 1);
+            auto write = [&](size_t c) {
+                glm::mat4* palette = layout == 0 ? heapPalettes[c].data() : slabPalettes[c];
+                for (size_t b = 0; b < bones; ++b)
+                    palette[b] = globals[b] * offsets[b];
+            };
+            return TimeRuns(layout == 0 ? "heap" : "slab", options, [&] {
+                auto start = std::chrono::steady_clock::now();
+                for (int pass = 0; pass < passes; ++pass)
+                    jobs.ParallelFor(characters, write);
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                return ns / (passes * characters);
+            });
+        });
+        for (glm::mat4* palette : slabPalettes)
+            slab.Free(palette, bones);
+    }
+
+    // dTLB read misses per frame in each stage for a crowd large enough that
+    // its clips, palettes and pose scratch span far more 4 KB pages than the
+    // dTLB holds. The storage is chosen at startup, so the comparison is two
+    // runs: without --huge-pages and with it.
+    inline void RunTlb(Assets& assets, const Options& options)
+    {
+        if (!FrameProfiler::EnableCounters())
+            std::printf("tlb: no hardware counters here, only frame times are meaningful\n");
+        const Scenario scenario = { "tlb", 2048, 120, false, true };
+        int run = 0;
+        double misses[FrameProfiler::STAGE_COUNT] = {};
+        Summary frame = TimeRuns("frame", options, [&] {
+            double ms = RunScenario(scenario, assets)[0];
+            if (run++ >= options.warmup)
+                for (int s = 0; s < FrameProfiler::STAGE_COUNT; ++s)
+                    misses[s] += FrameProfiler::GetAverageCounter(s, PERF_DTLB_MISSES) / options.runs;
+            return ms;
+        });
+
+        HugePages::Report();
+        GetPaletteSlab().Report();
+        std::printf("tlb: %d characters, %.3f +-%.3f ms/frame\n", scenario.characters, frame.mean, frame.ci95);
+        std::printf("%-10s %14s %16s\n", "stage", "dTLB miss", "per character");
+        double total = 0.0;
+        for (int s = 0; s < FrameProfiler::STAGE_COUNT; ++s)
+        {
+            std::printf("%-10s %14.0f %16.2f\n", FrameProfiler::GetStageName(s), misses[s], misses[s] / scenario.characters);
+            total += misses[s];
+        }
+        std::printf("%-10s %14.0f %16.2f\n", "total", total, total / scenario.characters);
+    }
+
+    inline int Run(int argc, char** argv)
+    {
+        Options options = ParseOptions(argc, argv);
+        int cpu = options.cpu >= 0 ? options.cpu : CpuTopology::GetSlotCpu(0).cpu;
+        if (CpuTopology::PinCurrentThread(cpu))
+            std::printf("bench: pinned to CPU %d\n", cpu);
+        else
+            std::printf("bench: running unpinned\n");
+
+        if (options.behaviours)
+            return RunBehaviours(options) ? 0 : 1;
+
+        Assets assets;
+        if (!LoadAssets(assets))
+        {
+            std::printf("bench: could not load the animation clips\n");
+            return 2;
+        }
+        if (options.mirror)
+            return RunMirror(assets, options) ? 0 : 1;
+        if (options.palettes)
+        {
+            RunPaletteScaling(assets, options);
+            return 0;
+        }
+        if (options.tlb)
+        {
+            RunTlb(assets, options);
+            return 0;
+        }
+
+        const Scenario scenarios[] = { { "single", 1, 600 }, { "crowd", 256, 300 }, { "graph", 256, 300, true },
+            { "varied", 256, 300, false, true } };
+        // The graph needs the rig's spine and right arm; without them the
+        // graph scenario would time nothing and pass any baseline
+        CrowdGraph probe = BuildCrowdGraph(assets);
+        if (!probe.graph)
+        {
+            std::printf("bench: the crowd graph does not compile for this skeleton\n");
+            return 2;
+        }
+        delete probe.graph;
+        // Every scenario with a crowd to split across threads, so the graph's
+        // blend, mask and IK paths are covered along with plain clips
+        if (options.determinism)
+        {
+            bool identical = true;
+            for (const Scenario& scenario : scenarios)
+                if (scenario.characters > 1)
+                    identical = RunDeterminism(scenario, assets) && identical;
+            return identical ? 0 : 1;
+        }
+
+        std::vector<std::string> metricNames = { "frame" };
+        for (int s = 0; s < FrameProfiler::STAGE_COUNT; ++s)
+            metricNames.push_back(FrameProfiler::GetStageName(s));
+
+        JsonValue results = JsonValue::MakeObject();
+        results.Set("version", JsonValue::MakeNumber(1));
+        results.Set("runs", JsonValue::MakeNumber(options.runs));
+        JsonValue& scenarioResults = results.Set("scenarios", JsonValue::MakeObject());
+
+        std::vector<std::pair<std::string, Summary>> summaries; // "scenario/metric"
+        for (const Scenario& scenario : scenarios)
+        {
+            for (int i = 0; i < options.warmup; ++i)
+                RunScenario(scenario, assets);
+            std::vector<std::vector<double>> samples(metricNames.size());
+            for (int run = 0; run < options.runs; ++run)
+            {
+                std::vector<double> metrics = RunScenario(scenario, assets);
+                for (size_t m = 0; m < metrics.size(); ++m)
+                    samples[m].push_back(metrics[m]);
+            }
+
+            JsonValue& metricsJson = scenarioResults.Set(scenario.name, JsonValue::MakeObject());
+            for (size_t m = 0; m < metricNames.size(); ++m)
+            {
+                Summary summary = Summarize(metricNames[m], samples[m]);
+                JsonValue entry = JsonValue::MakeObject();
+                entry.Set("mean", JsonValue::MakeNumber(summary.mean));
+                entry.Set("stddev", JsonValue::MakeNumber(summary.stddev));
+                entry.Set("ci95", JsonValue::MakeNumber(summary.ci95));
+                entry.Set("runs", JsonValue::MakeNumber(summary.runs));
+                metricsJson.Set(metricNames[m], entry);
+                summaries.push_back({ scenario.name, summary });
+            }
+        }
+
+        JsonValue baseline;
+        bool haveBaseline = !options.baselinePath.empty() && ReadJson(options.baselinePath, baseline);
+        if (!options.baselinePath.empty() && !haveBaseline)
+            std::printf("bench: no readable baseline at %s, reporting only\n", options.baselinePath.c_str());
+
+        int regressions = 0;
+        std::printf("%-8s %-10s %12s %10s %12s %10s %8s\n", "scenario", "metric", "ms/frame", "+-95%", "baseline", "+-95%", "change");
+        for (const auto& entry : summaries)
+        {
+            const Summary& now = entry.second;
+            const JsonValue& base = baseline["scenarios"][entry.first.c_str()][now.name.c_str()];
+            if (!haveBaseline || base.IsNull())
+            {
+                std::printf("%-8s %-10s %12.4f %10.4f\n", entry.first.c_str(), now.name.c_str(), now.mean, now.ci95);
+                continue;
+            }
+            double baseMean = base["mean"].AsDouble();
+            double baseCi = base["ci95"].AsDouble();
+            double change = baseMean > 0.0 ? (now.mean - baseMean) / baseMean * 100.0 : 0.0;
+            bool slower = change > options.threshold;
+            bool separated = now.mean - now.ci95 > baseMean + baseCi;
+            std::printf("%-8s %-10s %12.4f %10.4f %12.4f %10.4f %+7.1f%%%s\n", entry.first.c_str(), now.name.c_str(),
+                now.mean, now.ci95, baseMean, baseCi, change, slower && separated ? "  REGRESSION" : "");
+            if (slower && separated)
+            {
+                std::printf("  %s/%s is %.1f%% slower than the baseline (threshold %.1f%%), and its 95%% interval "
+                    "[%.4f, %.4f] lies above the baseline's [%.4f, %.4f]\n",
+                    entry.first.c_str(), now.name.c_str(), change, options.threshold,
+                    now.mean - now.ci95, now.mean + now.ci95, baseMean - baseCi, baseMean + baseCi);
+                regressions++;
+            }
+            else if (slower)
+                std::printf("  %s/%s is %.1f%% slower but within noise (intervals overlap); rerun with more --runs to decide\n",
+                    entry.first.c_str(), now.name.c_str(), change);
+        }
+
+        if (options.scaling)
+        {
+            RunScaling(scenarios[1], assets, options);
+            CpuTopology::PinCurrentThread(cpu);
+        }
+
+        if (!options.saveBaselinePath.empty())
+        {
+            std::ofstream file(options.saveBaselinePath, std::ios::binary | std::ios::trunc);
+            file << results.Dump(2) << "\n";
+            std::printf("bench: wrote baseline %s\n", options.saveBaselinePath.c_str());
+        }
+
+        if (regressions)
+            std::printf("bench: %d metric(s) regressed\n", regressions);
+        return regressions ? 1 : 0;
+    }
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "job_system.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The codecs are opt-in: the build defines BLOB_CODEC_WITH_LZ4 and/or
+// BLOB_CODEC_WITH_ZSTD together with -llz4 / -lzstd. Finding the headers is
+// not enough, since an unchanged build would then fail to link.
+#ifdef BLOB_CODEC_WITH_LZ4
+#include <lz4.h>
+#define BLOB_CODEC_HAS_LZ4 1
+#else
+#define BLOB_CODEC_HAS_LZ4 0
+#endif
+
+#ifdef BLOB_CODEC_WITH_ZSTD
+#include <zstd.h>
+#define BLOB_CODEC_HAS_ZSTD 1
+#else
+#define BLOB_CODEC_HAS_ZSTD 0
+#endif
+
+// Chunked compression for large asset blobs. A blob is cut into CHUNK_SIZE
+// pieces that are compressed independently, so loading can decode them on
+// every job worker at once, and each worker pulls in (page faults) only its
+// own part of a mapped file while the others decode. LZ4 decodes at several
+// GB/s and suits data needed at startup; Zstd packs tighter for data where
+// disk size matters more. A chunk that does not shrink is stored as is.
+//
+// Packed layout: ChunkEntry[chunkCount], then the chunks' bytes, with each
+// entry's offset counted from the end of the table.
+namespace BlobCodec
+{
+    enum class Codec : uint32_t
+    {
+        Stored = 0,
+        LZ4 = 1,
+        Zstd = 2,
+    };
+
+    const size_t CHUNK_SIZE = 256 * 1024;
+    // Only paid at bake time; Zstd decode speed barely depends on the level
+    const int ZSTD_LEVEL = 15;
+
+    struct ChunkEntry
+    {
+        uint32_t codec;
+        uint32_t rawSize;
+        uint32_t packedSize;
+        uint32_t reserved;
+        uint64_t offset;
+    };
+
+    struct DecodeStats
+    {
+        std::string name;
+        Codec codec;
+        size_t chunks;
+        uint64_t packedBytes;
+        uint64_t rawBytes;
+        double milliseconds;
+    };
+
+    inline std::vector<DecodeStats> history;
+
+    inline const char* GetName(Codec codec)
+    {
+        switch (codec)
+        {
+        case Codec::Stored: return "none";
+        case Codec::LZ4: return "lz4";
+        case Codec::Zstd: return "zstd";
+        }
+        return "?";
+    }
+
+    inline bool IsAvailable(Codec codec)
+    {
+        switch (codec)
+        {
+        case Codec::Stored: return true;
+        case Codec::LZ4: return BLOB_CODEC_HAS_LZ4 != 0;
+        case Codec::Zstd: return BLOB_CODEC_HAS_ZSTD != 0;
+        }
+        return false;
+    }
+
+    inline bool Parse(const char* name, Codec& codec)
+    {
+        for (Codec candidate : { Codec::Stored, Codec::LZ4, Codec::Zstd })
+        {
+            if (std::strcmp(name, GetName(candidate)) == 0)
+            {
+                codec = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Fast decode wins for startup data when it is built in
+    inline Codec GetDefault()
+    {
+        return IsAvailable(Codec::LZ4) ? Codec::LZ4 : Codec::Stored;
+    }
+
+    // Compresses one chunk into `out`; false when the codec is missing or the
+    // result would not be smaller
+    inline bool CompressChunk(Codec codec, const uint8_t* src, size_t size, std::vector<uint8_t>& out)
+    {
+#if BLOB_CODEC_HAS_LZ4
+        if (codec == Codec::LZ4)
+        {
+            out.resize((size_t)LZ4_compressBound((int)size));
+            int packed = LZ4_compress_default((const char*)src, (char*)out.data(), (int)size, (int)out.size());
+            if (packed <= 0 || (size_t)packed >= size)
+                return false;
+            out.resize((size_t)packed);
+            return true;
+        }
+#endif
+#if BLOB_CODEC_HAS_ZSTD
+        if (codec == Codec::Zstd)
+        {
+            out.resize(ZSTD_compressBound(size));
+            size_t packed = ZSTD_compress(out.data(), out.size(), src, size, ZSTD_LEVEL);
+            if (ZSTD_isError(packed) || packed >= size)
+                return false;
+            out.resize(packed);
+            return true;
+        }
+#endif
+        (void)codec;
+        (void)src;
+        (void)size;
+        (void)out;
+        return false;
+    }
+
+    inline bool DecompressChunk(Codec codec, const uint8_t* src, size_t packedSize, uint8_t* dst, size_t rawSize)
+    {
+        if (codec == Codec::Stored)
+        {
+            if (packedSize != rawSize)
+                return false;
+            std::memcpy(dst, src, rawSize);
+            return true;
+        }
+#if BLOB_CODEC_HAS_LZ4
+        if (codec == Codec::LZ4)
+            return LZ4_decompress_safe((const char*)src, (char*)dst, (int)packedSize, (int)rawSize) == (int)rawSize;
+#endif
+#if BLOB_CODEC_HAS_ZSTD
+        if (codec == Codec::Zstd)
+        {
+            // One context per thread instead of one allocation per chunk
+            thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            return context && ZSTD_decompressDCtx(context.get(), dst, rawSize, src, packedSize) == rawSize;
+        }
+#endif
+        (void)dst;
+        return false;
+    }
+
+    // Appends the packed form of `size` bytes (table, then chunks) to `out`;
+    // returns the chunk count. Chunks are compressed in parallel.
+    inline uint32_t Compress(const void* data, size_t size, Codec codec, std::vector<uint8_t>& out)
+    {
+        const uint8_t* src = (const uint8_t*)data;
+        size_t count = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        std::vector<std::vector<uint8_t>> packed(count);
+        std::vector<ChunkEntry> chunks(count);
+        GetJobSystem().ParallelFor(count, [&](size_t c) {
+            size_t rawSize = std::min(CHUNK_SIZE, size - c * CHUNK_SIZE);
+            chunks[c] = { (uint32_t)codec, (uint32_t)rawSize, 0, 0, 0 };
+            if (!CompressChunk(codec, src + c * CHUNK_SIZE, rawSize, packed[c]))
+            {
+                chunks[c].codec = (uint32_t)Codec::Stored;
+                packed[c].assign(src + c * CHUNK_SIZE, src + c * CHUNK_SIZE + rawSize);
+            }
+            chunks[c].packedSize = (uint32_t)packed[c].size();
+        });
+
+        uint64_t offset = 0;
+        for (ChunkEntry& chunk : chunks)
+        {
+            chunk.offset = offset;
+            offset += chunk.packedSize;
+        }
+        size_t tableStart = out.size();
+        out.resize(tableStart + count * sizeof(ChunkEntry));
+        std::memcpy(out.data() + tableStart, chunks.data(), count * sizeof(ChunkEntry));
+        for (const std::vector<uint8_t>& chunk : packed)
+            out.insert(out.end(), chunk.begin(), chunk.end());
+        return (uint32_t)count;
+    }
+
+    // Decodes a packed blob of `packedSize` bytes holding `chunkCount` chunks
+    // into dst, which must take exactly rawSize bytes. Every entry is checked
+    // against both buffers first, so a corrupt file fails instead of writing
+    // out of bounds.
+    inline bool Decompress(const std::string& name, const uint8_t* packed, size_t packedSize, uint32_t chunkCount,
+        void* dst, size_t rawSize)
+    {
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point start = Clock::now();
+
+        size_t tableSize = (size_t)chunkCount * sizeof(ChunkEntry);
+        if (tableSize > packedSize)
+            return false;
+        std::vector<ChunkEntry> chunks(chunkCount);
+        std::memcpy(chunks.data(), packed, tableSize);
+        const uint8_t* base = packed + tableSize;
+        size_t available = packedSize - tableSize;
+
+        std::vector<size_t> rawOffsets(chunkCount);
+        size_t rawTotal = 0;
+        for (uint32_t c = 0; c < chunkCount; ++c)
+        {
+            const ChunkEntry& chunk = chunks[c];
+            if (chunk.codec > (uint32_t)Codec::Zstd || chunk.rawSize > CHUNK_SIZE
+                || chunk.offset > available || chunk.packedSize > available - chunk.offset)
+                return false;
+            rawOffsets[c] = rawTotal;
+            rawTotal += chunk.rawSize;
+        }
+        if (rawTotal != rawSize)
+            return false;
+
+        std::atomic<bool> ok{ true };
+        GetJobSystem().ParallelFor(chunkCount, [&](size_t c) {
+            const ChunkEntry& chunk = chunks[c];
+            if (!DecompressChunk((Codec)chunk.codec, base + chunk.offset, chunk.packedSize,
+                    (uint8_t*)dst + rawOffsets[c], chunk.rawSize))
+                ok.store(false, std::memory_order_relaxed);
+        });
+
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        Codec codec = Codec::Stored;
+        for (const ChunkEntry& chunk : chunks)
+            if (chunk.codec != (uint32_t)Codec::Stored)
+                codec = (Codec)chunk.codec;
+        history.push_back({ name, codec, chunkCount, packedSize, rawSize, ms });
+        return ok.load();
+    }
+
+    // ioMilliseconds: time spent reading the same files, for the effective
+    // rate (raw bytes delivered per second of read plus decode)
+    inline void Report(double ioMilliseconds)
+    {
+        if (history.empty())
+            return;
+        uint64_t packedTotal = 0;
+        uint64_t rawTotal = 0;
+        double msTotal = 0.0;
+        for (const DecodeStats& s : history)
+        {
+            std::printf("decode %-5s %5zu chunks %9.2f -> %9.2f MB (%.2fx) %9.2f ms %9.1f MB/s  %s\n",
+                GetName(s.codec), s.chunks, s.packedBytes / (1024.0 * 1024.0), s.rawBytes / (1024.0 * 1024.0),
+                s.packedBytes ? (double)s.rawBytes / s.packedBytes : 0.0, s.milliseconds,
+                s.milliseconds > 0.0 ? s.rawBytes / (1024.0 * 1024.0) / (s.milliseconds / 1000.0) : 0.0, s.name.c_str());
+            packedTotal += s.packedBytes;
+            rawTotal += s.rawBytes;
+            msTotal += s.milliseconds;
+        }
+        double seconds = (ioMilliseconds + msTotal) / 1000.0;
+        std::printf("blobs %.2f MB on disk, %.2f MB raw, %.2f ms io + %.2f ms decode: %.1f MB/s effective\n",
+            packedTotal / (1024.0 * 1024.0), rawTotal / (1024.0 * 1024.0), ioMilliseconds, msTotal,
+            seconds > 0.0 ? rawTotal / (1024.0 * 1024.0) / seconds : 0.0);
+    }
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "anim_clip.h"
+#include "anim_graph.h"
+#include "asset_handles.h"
+#include "clip_mirror.h"
+#include "frame_profiler.h"
+#include "palette_slab.h"
+#include "pose_arena.h"
+#include "skeleton.h"
+#include "skinned_model.h"
+#include "time_warp.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <span>
+#include <string>
+#include <vector>
+
+// Per-character playback state. Replaces the recursive Animator pass with a
+// flat loop over the skeleton and keeps the model-space transforms around,
+// which is what sockets (and anything else that needs bone positions) read.
+class CharacterAnimator
+{
+public:
+    CharacterAnimator(Skeleton* skeleton, AnimClip* animation)
+        : m_Skeleton(skeleton)
+    {
+        assert(skeleton->GetPaletteSize() <= MAX_BONES);
+        m_PaletteSize = skeleton->GetPaletteSize();
+        m_FinalBoneMatrices = GetPaletteSlab().Allocate(m_PaletteSize);
+        std::fill(m_FinalBoneMatrices, m_FinalBoneMatrices + m_PaletteSize, glm::mat4(1.0f));
+        m_GlobalTransforms.assign(skeleton->GetNodes().size(), glm::mat4(1.0f));
+        m_SocketTransforms.assign(skeleton->GetSockets().size(), glm::mat4(1.0f));
+        PlayAnimation(animation);
+    }
+
+    CharacterAnimator(Skeleton* skeleton, ClipHandle clip)
+        : CharacterAnimator(skeleton, (AnimClip*)nullptr)
+    {
+        PlayAnimation(clip);
+    }
+
+    ~CharacterAnimator()
+    {
+        GetPaletteSlab().Free(m_FinalBoneMatrices, m_PaletteSize);
+    }
+
+    CharacterAnimator(const CharacterAnimator&) = delete;
+    CharacterAnimator& operator=(const CharacterAnimator&) = delete;
+
+    // A mirror plays the clip mirrored while sampling (see ClipMirror),
+    // without a baked copy of it
+    void PlayAnimation(AnimClip* animation, const ClipMirror* mirror = nullptr)
+    {
+        assert(!mirror || mirror->GetSkeleton() == m_Skeleton);
+        m_Graph = nullptr;
+        m_Mirror = mirror;
+        m_ClipHandle = ClipHandle();
+        m_CurrentAnimation = animation;
+        m_CurrentTime = 0.0f;
+        m_LoopCount = 0;
+        m_ClipTracks = animation ? &m_Skeleton->BindClip(animation) : nullptr;
+        m_PoseDirty = true;
+    }
+
+    // Plays a clip from AssetHandles::clips. The handle is resolved again
+    // every frame, so a hot-reloaded clip is picked up at the same playhead
+    // and a released one stops playback instead of dangling.
+    void PlayAnimation(ClipHandle clip, const ClipMirror* mirror = nullptr)
+    {
+        PlayAnimation(AssetHandles::clips.Resolve(clip), mirror);
+        m_ClipHandle = clip;
+    }
+
+    // Drives the pose from a compiled graph (built for this skeleton) instead
+    // of a single clip. The graph's BeginFrame must run each frame before
+    // this character is evaluated.
+    void PlayGraph(const AnimGraph* graph)
+    {
+        assert(graph->GetSkeleton() == m_Skeleton);
+        PlayAnimation((AnimClip*)nullptr);
+        m_Graph = graph;
+        m_GraphParams = graph->GetInstanceDefaults();
+    }
+
+    // Per-character graph parameter, by the id AnimGraphBuilder returned
+    void SetParameter(uint16_t param, float value)
+    {
+        m_GraphParams[param] = value;
+        m_PoseDirty = true;
+    }
+
+    void SetParameter(uint16_t param, const glm::vec3& value)
+    {
+        m_GraphParams[param] = value.x;
+        m_GraphParams[param + 1] = value.y;
+        m_GraphParams[param + 2] = value.z;
+        m_PoseDirty = true;
+    }
+
+    // Playback settings belong to the character, not the clip, and survive
+    // PlayAnimation. Rate scales the clip's own speed (0 holds the pose). Phase
+    // shifts where in its cycle the clip is sampled, as a fraction of its
+    // length, and the warp then remaps that position; both leave the
+    // playhead, and so GetLoopCount, alone. Graphs only take the rate.
+    void SetRate(float rate)
+    {
+        m_Rate = std::max(rate, 0.0f);
+    }
+
+    void SetPhase(float phase)
+    {
+        m_Phase = phase - std::floor(phase);
+        m_PoseDirty = true;
+    }
+
+    // Must outlive its use here; null for none
+    void SetTimeWarp(const TimeWarp* warp)
+    {
+        m_Warp = warp;
+        m_PoseDirty = true;
+    }
+
+    void UpdateAnimation(float dt)
+    {
+        AdvanceTime(dt);
+        Evaluate();
+    }
+
+    // Moves the playhead only. Cheap enough to run for every character every
+    // frame, so a character whose pose is not re-evaluated stays in sync.
+    // Also where a clip handle is resolved, so call it inside the frame's
+    // EpochScope.
+    void AdvanceTime(float dt)
+    {
+        if (m_Graph)
+        {
+            for (uint16_t clock : m_Graph->GetInstanceClocks())
+                m_GraphParams[clock] += dt * m_Rate;
+            m_PoseDirty = true;
+            return;
+        }
+        if (m_ClipHandle.IsValid())
+        {
+            AnimClip* clip = AssetHandles::clips.Resolve(m_ClipHandle);
+            if (clip != m_CurrentAnimation)
+            {
+                m_CurrentAnimation = clip;
+                m_ClipTracks = clip ? &m_Skeleton->BindClip(clip) : nullptr;
+            }
+        }
+        if (!m_CurrentAnimation)
+            return;
+
+        m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * m_Rate * dt;
+        if (m_CurrentAnimation->GetDuration() > 0.0f && m_CurrentTime >= m_CurrentAnimation->GetDuration())
+            m_LoopCount += (int)(m_CurrentTime / m_CurrentAnimation->GetDuration());
+        m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
+        m_PoseDirty = true;
+    }
+
+    // Runs the hierarchy pass for the current playhead
+    void Evaluate()
+    {
+        if (!m_CurrentAnimation && !m_Graph)
+            return;
+        m_PoseDirty = false;
+
+        // Three flat passes rather than one fused loop, so each stage can be
+        // profiled (and its data layout tuned) on its own
+        const std::vector<SkeletonNode>& nodes = m_Skeleton->GetNodes();
+
+        // Local transforms are only needed inside this call: take them from
+        // the evaluating thread's arena rather than keeping them per character
+        PoseArena& arena = PoseArena::ForThisThread();
+        PoseArena::Scope scratch(arena);
+        glm::mat4* localTransforms = arena.Allocate<glm::mat4>(nodes.size());
+        {
+            ProfileScope profile(ProfileStage::Sampling);
+            if (m_Graph)
+            {
+                const NodeTransform* pose = m_Graph->Evaluate(m_GraphParams.data(), arena);
+                for (size_t i = 0; i < nodes.size(); ++i)
+                    localTransforms[i] = pose[i].ToMatrix();
+            }
+            else if (m_Mirror)
+            {
+                const std::vector<int>& tracks = *m_ClipTracks;
+                float time = GetSampleTime();
+                for (size_t i = 0; i < nodes.size(); ++i)
+                {
+                    int source = m_Mirror->GetPair((int)i);
+                    localTransforms[i] = m_Mirror->Apply((int)i, tracks[source] >= 0
+                        ? m_CurrentAnimation->SampleLocal(tracks[source], time) : nodes[source].bindLocal);
+                }
+            }
+            else
+            {
+                const std::vector<int>& tracks = *m_ClipTracks;
+                float time = GetSampleTime();
+                for (size_t i = 0; i < nodes.size(); ++i)
+                    localTransforms[i] = tracks[i] >= 0 ? m_CurrentAnimation->SampleLocal(tracks[i], time) : nodes[i].bindLocal;
+            }
+        }
+        {
+            ProfileScope profile(ProfileStage::Hierarchy);
+            for (size_t i = 0; i < nodes.size(); ++i)
+            {
+                int parent = nodes[i].parent;
+                m_GlobalTransforms[i] = parent < 0 ? localTransforms[i] : m_GlobalTransforms[parent] * localTransforms[i];
+            }
+        }
+        {
+            ProfileScope profile(ProfileStage::Skinning);
+            for (size_t i = 0; i < nodes.size(); ++i)
+                if (nodes[i].boneIndex >= 0)
+                    m_FinalBoneMatrices[nodes[i].boneIndex] = m_GlobalTransforms[i] * nodes[i].offset;
+
+            // O(sockets): read the node transform the pass just produced
+            const std::vector<BoneSocket>& sockets = m_Skeleton->GetSockets();
+            int slot = m_Skeleton->GetBoneCount();
+            for (size_t i = 0; i < sockets.size(); ++i, ++slot)
+            {
+                m_SocketTransforms[i] = m_GlobalTransforms[sockets[i].node] * sockets[i].localOffset;
+                m_FinalBoneMatrices[slot] = m_SocketTransforms[i];
+            }
+        }
+    }
+
+    // Bones followed by sockets, ready for a single glUniformMatrix4fv. The
+    // storage is this character's part of GetPaletteSlab().
+    std::span<const glm::mat4> GetFinalBoneMatrices() const { return { m_FinalBoneMatrices, m_PaletteSize }; }
+    // Model-space transform of every skeleton node
+    const std::vector<glm::mat4>& GetGlobalTransforms() const { return m_GlobalTransforms; }
+    // Model-space transform of every socket, in Skeleton::GetSockets() order
+    const std::vector<glm::mat4>& GetSocketTransforms() const { return m_SocketTransforms; }
+
+    Skeleton* GetSkeleton() const { return m_Skeleton; }
+    AnimClip* GetCurrentAnimation() const { return m_CurrentAnimation; }
+    float GetCurrentTime() const { return m_CurrentTime; }
+    float GetRate() const { return m_Rate; }
+    float GetPhase() const { return m_Phase; }
+    // Invalid when playing a raw clip pointer
+    ClipHandle GetClipHandle() const { return m_ClipHandle; }
+    // Set while the clip is mirrored in the sampling loop
+    const ClipMirror* GetMirror() const { return m_Mirror; }
+    // Times the playhead wrapped since PlayAnimation; a one-shot clip has
+    // finished once this is non-zero
+    int GetLoopCount() const { return m_LoopCount; }
+    // True when the playhead or clip changed since the last Evaluate()
+    bool IsPoseDirty() const { return m_PoseDirty; }
+
+private:
+    // Where the clip is sampled: the playhead shifted by the phase and
+    // remapped by the warp, in ticks
+    float GetSampleTime() const
+    {
+        float duration = m_CurrentAnimation->GetDuration();
+        if ((m_Phase == 0.0f && !m_Warp) || duration <= 0.0f)
+            return m_CurrentTime;
+        float position = m_CurrentTime / duration + m_Phase;
+        position -= std::floor(position);
+        if (m_Warp)
+            position = m_Warp->Evaluate(position);
+        return position * duration;
+    }
+
+    Skeleton* m_Skeleton;
+    ClipHandle m_ClipHandle;
+    AnimClip* m_CurrentAnimation = nullptr; // resolved for this frame when playing by handle
+    const std::vector<int>* m_ClipTracks = nullptr;
+    const ClipMirror* m_Mirror = nullptr;
+    const AnimGraph* m_Graph = nullptr;
+    std::vector<float> m_GraphParams;
+    float m_CurrentTime = 0.0f;
+    int m_LoopCount = 0;
+    float m_Rate = 1.0f;
+    float m_Phase = 0.0f;
+    const TimeWarp* m_Warp = nullptr;
+    bool m_PoseDirty = true;
+
+    glm::mat4* m_FinalBoneMatrices;
+    size_t m_PaletteSize;
+    std::vector<glm::mat4> m_GlobalTransforms;
+    std::vector<glm::mat4> m_SocketTransforms;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "anim_clip.h"
+#include "skeleton.h"
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class MirrorAxis
+{
+    X,
+    Y,
+    Z
+};
+
+// Plays a clip as its left/right mirror image, so only one of a symmetric
+// pair of clips (Left Turn / Right Turn) has to be authored and loaded.
+//
+// Nodes are paired by name ("mixamorig:LeftArm" <-> "mixamorig:RightArm");
+// the rest pair with themselves. A node's mirrored pose is its partner's pose
+// reflected across the plane normal to the axis (in model space). Rig bones
+// seldom have mirrored local axes, so the reflection is corrected per node
+// against the bind pose:
+//
+//   local'(n) = Inverse(C(parent(n))) * local(pair(n)) * C(n)
+//   C(n)      = Inverse(bindGlobal(pair(n))) * Reflect * bindGlobal(n)
+//
+// which maps the bind pose onto itself. Both factors are computed once here.
+// A clip can then be mirrored two ways:
+//  - while sampling (CharacterAnimator::PlayAnimation with a mirror): no
+//    extra clip memory, two more matrix products per node per evaluation
+//  - baked with Bake(): a second clip as cheap to sample as any other
+class ClipMirror
+{
+public:
+    ClipMirror(const Skeleton* skeleton, MirrorAxis axis = MirrorAxis::X,
+        const std::string& left = "Left", const std::string& right = "Right")
+        : m_Skeleton(skeleton)
+    {
+        const std::vector<SkeletonNode>& nodes = skeleton->GetNodes();
+        m_Pairs.resize(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            m_Pairs[i] = (int)i;
+            const std::string& name = nodes[i].name;
+            for (const auto& [from, to] : { std::pair(left, right), std::pair(right, left) })
+            {
+                size_t at = name.find(from);
+                if (at == std::string::npos)
+                    continue;
+                int pair = skeleton->FindNode(name.substr(0, at) + to + name.substr(at + from.size()));
+                if (pair >= 0)
+                    m_Pairs[i] = pair;
+                break;
+            }
+        }
+
+        // Parents come before children, so a pairing is dropped at the first
+        // node where the two sides' hierarchies differ and the check below
+        // it sees the corrected parents
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            int pair = m_Pairs[i];
+            int parent = nodes[i].parent;
+            bool symmetric = m_Pairs[pair] == (int)i
+                && (parent < 0 ? nodes[pair].parent < 0 : nodes[pair].parent == m_Pairs[parent]);
+            if (!symmetric)
+            {
+                std::cout << "MIRROR: " << nodes[i].name << " and " << nodes[pair].name
+                          << " are not mirror images, left unmirrored" << std::endl;
+                m_Pairs[pair] = pair;
+                m_Pairs[i] = (int)i;
+            }
+        }
+        for (size_t i = 0; i < nodes.size(); ++i)
+            if (m_Pairs[i] != (int)i)
+                m_PairedCount++;
+
+        glm::mat4 reflect(1.0f);
+        reflect[(int)axis][(int)axis] = -1.0f;
+        std::vector<glm::mat4> bindGlobal(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i)
+            bindGlobal[i] = nodes[i].parent < 0 ? nodes[i].bindLocal : bindGlobal[nodes[i].parent] * nodes[i].bindLocal;
+        m_Post.resize(nodes.size());
+        m_Pre.resize(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i)
+            m_Post[i] = glm::inverse(bindGlobal[m_Pairs[i]]) * reflect * bindGlobal[i];
+        for (size_t i = 0; i < nodes.size(); ++i)
+            m_Pre[i] = nodes[i].parent < 0 ? reflect : glm::inverse(m_Post[nodes[i].parent]);
+    }
+
+    // Node whose source pose node `node` takes, mirrored
+    int GetPair(int node) const { return m_Pairs[node]; }
+    // Nodes with a partner on the other side (both sides counted)
+    int GetPairedCount() const { return m_PairedCount; }
+    const Skeleton* GetSkeleton() const { return m_Skeleton; }
+    size_t GetMemoryBytes() const
+    {
+        return m_Pairs.size() * sizeof(int) + (m_Pre.size() + m_Post.size()) * sizeof(glm::mat4);
+    }
+
+    // Mirrored local transform of `node`, from the source pose's local
+    // transform of GetPair(node)
+    glm::mat4 Apply(int node, const glm::mat4& sourceLocal) const
+    {
+        return m_Pre[node] * sourceLocal * m_Post[node];
+    }
+
+    // A new clip playing `clip` mirrored. Each channel keeps its key times and
+    // a missing channel gets one constant key, since the mirror of its
+    // default is not the default. Between keys the result matches the
+    // sampling path exactly when the rig is symmetric (C(n) without
+    // translation), and closely otherwise.
+    AnimClip* Bake(const AnimClip* clip) const
+    {
+        const std::vector<SkeletonNode>& nodes = m_Skeleton->GetNodes();
+        AnimClip* mirrored = new AnimClip();
+        mirrored->m_Duration = clip->m_Duration;
+        mirrored->m_TicksPerSecond = clip->m_TicksPerSecond;
+        mirrored->m_Nodes = clip->m_Nodes;
+        mirrored->m_Tracks.reserve(clip->m_Tracks.size());
+        for (size_t t = 0; t < clip->m_Tracks.size(); ++t)
+        {
+            const ClipTrack& source = clip->m_Tracks[t];
+            int sourceNode = m_Skeleton->FindNode(source.nodeName);
+            if (sourceNode < 0)
+            {
+                mirrored->m_Tracks.push_back(source); // not part of the rig
+                continue;
+            }
+            int node = m_Pairs[sourceNode];
+            auto sample = [&](float time) { return NodeTransform::FromMatrix(Apply(node, clip->SampleLocal((int)t, time))); };
+            auto keyTimes = [](const KeyVector<float>& times) { return times.empty() ? KeyVector<float>{ 0.0f } : times; };
+
+            ClipTrack track;
+            track.nodeName = nodes[node].name;
+            track.positionTimes = keyTimes(source.positionTimes);
+            for (float time : track.positionTimes)
+                track.positions.push_back(sample(time).translation);
+            track.rotationTimes = keyTimes(source.rotationTimes);
+            for (float time : track.rotationTimes)
+                track.rotations.push_back(sample(time).rotation);
+            track.scaleTimes = keyTimes(source.scaleTimes);
+            for (float time : track.scaleTimes)
+                track.scales.push_back(sample(time).scale);
+            mirrored->m_Tracks.push_back(std::move(track));
+        }
+        return mirrored;
+    }
+
+private:
+    const Skeleton* m_Skeleton;
+    std::vector<int> m_Pairs;
+    std::vector<glm::mat4> m_Pre;  // Inverse(C(parent)), or the reflection for roots
+    std::vector<glm::mat4> m_Post; // C(node)
+    int m_PairedCount = 0;
+};
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Core layout of the machine and where each of our threads should run.
+//
+// On Linux the layout comes from sysfs: SMT siblings, L3 (last-level cache)
+// domains and NUMA nodes of every CPU the process may use. Threads are given
+// CPUs in "slots": slot 0 is the main/render thread, slot k+1 is job worker k.
+// Slots fill one hardware thread per physical core first, staying in the main
+// thread's L3 domain and node as long as possible, and only then fall back to
+// SMT siblings, so workers neither share a core with the render thread nor
+// migrate across sockets. Elsewhere everything reports one flat domain and
+// pinning does nothing.
+namespace CpuTopology
+{
+    struct CpuInfo
+    {
+        int cpu = 0;
+        int core = 0;      // physical core id within the package
+        int package = 0;
+        int l3 = 0;        // lowest CPU sharing the last-level cache
+        int node = 0;      // NUMA node
+        int smtIndex = 0;  // 0 for the first hardware thread of a core
+    };
+
+    inline bool pinThreads = true;  // --no-pin turns this off
+    inline int workerNice = 2;      // workers run this much nicer than the render thread
+
+#ifdef __linux__
+    // Also reads the lowest entry of "0-3,8-11" style CPU lists
+    inline int ReadInt(const std::string& path, int fallback)
+    {
+        std::ifstream file(path);
+        int value;
+        return file >> value ? value : fallback;
+    }
+
+    inline int FindNode(int cpu)
+    {
+        std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        DIR* dir = opendir(path.c_str());
+        if (!dir)
+            return 0;
+        int node = 0;
+        while (dirent* entry = readdir(dir))
+        {
+            if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+            {
+                node = std::atoi(entry->d_name + 4);
+                break;
+            }
+        }
+        closedir(dir);
+        return node;
+    }
+
+    inline int FindL3(int cpu)
+    {
+        std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index";
+        int l3 = -1;
+        for (int index = 0; index < 8; ++index)
+        {
+            int level = ReadInt(path + std::to_string(index) + "/level", -1);
+            if (level < 0)
+                break;
+            if (level >= 3)
+                l3 = ReadInt(path + std::to_string(index) + "/shared_cpu_list", cpu);
+        }
+        return l3 >= 0 ? l3 : cpu;
+    }
+#endif
+
+    struct Topology
+    {
+        std::vector<CpuInfo> cpus;  // in slot order
+        int coreCount = 0;
+        int l3Count = 0;
+        int nodeCount = 0;
+#ifdef __linux__
+        cpu_set_t processMask;      // affinity the process started with
+#endif
+    };
+
+    inline Topology Detect()
+    {
+        Topology topology;
+#ifdef __linux__
+        CPU_ZERO(&topology.processMask);
+        if (sched_getaffinity(0, sizeof(topology.processMask), &topology.processMask) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (!CPU_ISSET(cpu, &topology.processMask))
+                    continue;
+                std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+                CpuInfo info;
+                info.cpu = cpu;
+                info.core = ReadInt(base + "core_id", cpu);
+                info.package = ReadInt(base + "physical_package_id", 0);
+                info.l3 = FindL3(cpu);
+                info.node = FindNode(cpu);
+                topology.cpus.push_back(info);
+            }
+        }
+#endif
+        if (topology.cpus.empty())
+        {
+            unsigned count = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned i = 0; i < count; ++i)
+            {
+                CpuInfo info;
+                info.cpu = info.core = (int)i;
+                topology.cpus.push_back(info);
+            }
+        }
+
+        // Number the hardware threads of each core in CPU order
+        for (CpuInfo& info : topology.cpus)
+            for (const CpuInfo& other : topology.cpus)
+                if (other.cpu < info.cpu && other.package == info.package && other.core == info.core)
+                    info.smtIndex++;
+
+        // Main thread's domain first, whole cores before siblings
+        const CpuInfo first = topology.cpus.front();
+        std::stable_sort(topology.cpus.begin(), topology.cpus.end(), [&first](const CpuInfo& a, const CpuInfo& b) {
+            if (a.smtIndex != b.smtIndex)
+                return a.smtIndex < b.smtIndex;
+            if ((a.node == first.node) != (b.node == first.node))
+                return a.node == first.node;
+            if (a.node != b.node)
+                return a.node < b.node;
+            if ((a.l3 == first.l3) != (b.l3 == first.l3))
+                return a.l3 == first.l3;
+            return a.l3 < b.l3;
+        });
+
+        std::vector<int> cores, l3s, nodes;
+        for (const CpuInfo& info : topology.cpus)
+        {
+            if (info.smtIndex == 0)
+                cores.push_back(info.cpu);
+            if (std::find(l3s.begin(), l3s.end(), info.l3) == l3s.end())
+                l3s.push_back(info.l3);
+            if (std::find(nodes.begin(), nodes.end(), info.node) == nodes.end())
+                nodes.push_back(info.node);
+        }
+        topology.coreCount = (int)cores.size();
+        topology.l3Count = (int)l3s.size();
+        topology.nodeCount = (int)nodes.size();
+        return topology;
+    }
+
+    // Detected on first use, before anything has been pinned
+    inline const Topology& Get()
+    {
+        static Topology topology = Detect();
+        return topology;
+    }
+
+    // CPU for a thread slot; wraps when there are more threads than CPUs
+    inline const CpuInfo& GetSlotCpu(unsigned slot)
+    {
+        const Topology& topology = Get();
+        return topology.cpus[slot % topology.cpus.size()];
+    }
+
+    inline bool PinCurrentThread(int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    // Back to every CPU the process may use. Threads inherit their creator's
+    // affinity, so unpinned workers spawned by a pinned thread need this.
+    inline void UnpinCurrentThread()
+    {
+#ifdef __linux__
+        const Topology& topology = Get();
+        sched_setaffinity(0, sizeof(topology.processMask), &topology.processMask);
+#endif
+    }
+
+    // Pins the calling thread to its slot, or releases it when pinning is off
+    inline void PlaceCurrentThread(unsigned slot, bool pin = pinThreads)
+    {
+        if (pin)
+            PinCurrentThread(GetSlotCpu(slot).cpu);
+        else
+            UnpinCurrentThread();
+    }
+
+    // Raises the nice value of the calling thread only (Linux schedules
+    // threads as tasks); going down in priority needs no privileges
+    inline void LowerCurrentThreadPriority(int steps)
+    {
+#ifdef __linux__
+        id_t thread = (id_t)syscall(SYS_gettid);
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, thread);
+        if (errno == 0)
+            setpriority(PRIO_PROCESS, thread, std::min(nice + steps, 19));
+#else
+        (void)steps;
+#endif
+    }
+
+    inline void Report()
+    {
+        const Topology& topology = Get();
+        std::printf("cpu topology: %d CPUs, %d cores, %d L3 domains, %d NUMA nodes, pinning %s\n",
+            (int)topology.cpus.size(), topology.coreCount, topology.l3Count, topology.nodeCount, pinThreads ? "on" : "off");
+        std::printf("  slot  cpu  core  pkg   l3  node  smt\n");
+        for (size_t slot = 0; slot < topology.cpus.size(); ++slot)
+        {
+            const CpuInfo& info = topology.cpus[slot];
+            std::printf("  %4d %4d %5d %4d %4d %5d %4d%s\n", (int)slot, info.cpu, info.core, info.package, info.l3,
+                info.node, info.smtIndex, slot == 0 ? "  main" : "");
+        }
+    }
+}
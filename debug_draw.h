@@ -0,0 +1,183 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/shader_m.h>
+
+#include "character_animator.h"
+#include "frustum.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+
+#include <cstddef>
+#include <vector>
+
+struct DebugVertex
+{
+    glm::vec3 position;
+    glm::vec3 color;
+};
+
+// Immediate-mode line overlay. Everything queued during a frame goes into one
+// streamed vertex buffer and is drawn with a single glDrawArrays in Flush().
+// While disabled every call returns straight away, so it can stay wired in.
+class DebugDraw
+{
+public:
+    bool enabled = false;
+
+    DebugDraw()
+        : m_Shader("debug_line.vs", "debug_line.fs")
+    {
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(1, &m_VBO);
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, color));
+        glBindVertexArray(0);
+    }
+
+    ~DebugDraw()
+    {
+        glDeleteBuffers(1, &m_VBO);
+        glDeleteVertexArrays(1, &m_VAO);
+        MemoryStats::TrackGpu(MemTag::Debug, -(int64_t)m_Capacity);
+    }
+
+    // Sets the camera used for culling and drawing this frame
+    void BeginFrame(const glm::mat4& viewProjection)
+    {
+        m_Vertices.clear();
+        m_CharactersDrawn = 0;
+        m_CharactersCulled = 0;
+        if (!enabled)
+            return;
+
+        m_ViewProjection = viewProjection;
+        m_Frustum = Frustum(viewProjection);
+    }
+
+    void AddLine(const glm::vec3& from, const glm::vec3& to, const glm::vec3& color)
+    {
+        if (!enabled)
+            return;
+        m_Vertices.push_back({ from, color });
+        m_Vertices.push_back({ to, color });
+    }
+
+    // World-space axis-aligned box
+    void AddBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& color)
+    {
+        if (!enabled)
+            return;
+        glm::vec3 c[8];
+        for (int i = 0; i < 8; ++i)
+            c[i] = glm::vec3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+        static const int edges[12][2] = {
+            { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+            { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+            { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+        for (const auto& e : edges)
+            AddLine(c[e[0]], c[e[1]], color);
+    }
+
+    // Bones, joint bounds and LOD tier (as colour) of one character. Characters
+    // whose bounds are outside the frustum are skipped before any line is built.
+    void AddCharacter(const CharacterAnimator& animator, const glm::mat4& model, int lodTier = 0)
+    {
+        if (!enabled)
+            return;
+
+        const std::vector<SkeletonNode>& nodes = animator.GetSkeleton()->GetNodes();
+        const std::vector<glm::mat4>& globals = animator.GetGlobalTransforms();
+
+        m_Joints.resize(nodes.size());
+        glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            glm::vec3 p = glm::vec3(model * globals[i][3]);
+            m_Joints[i] = p;
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius = glm::length(boundsMax - center);
+        if (!m_Frustum.IsSphereVisible(center, radius))
+        {
+            m_CharactersCulled++;
+            return;
+        }
+
+        glm::vec3 tierColor = GetLodColor(lodTier);
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            if (nodes[i].parent < 0)
+                continue;
+            glm::vec3 color = nodes[i].boneIndex >= 0 ? glm::vec3(1.0f, 1.0f, 0.2f) : glm::vec3(0.5f);
+            AddLine(m_Joints[nodes[i].parent], m_Joints[i], color);
+        }
+        AddBox(boundsMin, boundsMax, tierColor);
+        m_CharactersDrawn++;
+    }
+
+    // Uploads everything queued this frame and draws it in one call
+    void Flush()
+    {
+        if (!enabled || m_Vertices.empty())
+            return;
+
+        GLsizeiptr bytes = (GLsizeiptr)(m_Vertices.size() * sizeof(DebugVertex));
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        if (bytes > m_Capacity)
+        {
+            MemoryStats::TrackGpu(MemTag::Debug, (int64_t)(bytes * 2 - m_Capacity));
+            m_Capacity = bytes * 2;
+        }
+        // Orphan every frame so the driver does not stall on last frame's draw
+        glBufferData(GL_ARRAY_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, m_Vertices.data());
+
+        m_Shader.use();
+        m_Shader.setMat4("viewProjection", m_ViewProjection);
+        glDisable(GL_DEPTH_TEST);
+        RenderStats::BindVertexArray(m_VAO);
+        glDrawArrays(GL_LINES, 0, (GLsizei)m_Vertices.size());
+        RenderStats::CountDraw();
+        RenderStats::BindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    int GetCharactersDrawn() const { return m_CharactersDrawn; }
+    int GetCharactersCulled() const { return m_CharactersCulled; }
+    size_t GetVertexCount() const { return m_Vertices.size(); }
+
+private:
+    static glm::vec3 GetLodColor(int tier)
+    {
+        static const glm::vec3 colors[] = {
+            glm::vec3(0.2f, 1.0f, 0.2f),   // full detail
+            glm::vec3(0.2f, 0.6f, 1.0f),
+            glm::vec3(1.0f, 0.6f, 0.1f),
+            glm::vec3(1.0f, 0.2f, 0.2f) }; // cheapest
+        return colors[glm::clamp(tier, 0, 3)];
+    }
+
+    Shader m_Shader;
+    unsigned int m_VAO = 0;
+    unsigned int m_VBO = 0;
+    GLsizeiptr m_Capacity = 0;
+
+    glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+    Frustum m_Frustum;
+
+    std::vector<DebugVertex> m_Vertices;
+    std::vector<glm::vec3> m_Joints;   // scratch, reused across characters
+    int m_CharactersDrawn = 0;
+    int m_CharactersCulled = 0;
+};
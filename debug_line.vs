@@ -0,0 +1,14 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 color;
+
+uniform mat4 viewProjection;
+
+out vec3 LineColor;
+
+void main()
+{
+    gl_Position = viewProjection * vec4(pos, 1.0f);
+    LineColor = color;
+}
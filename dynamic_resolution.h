@@ -0,0 +1,197 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Renders the scene into an offscreen target and scales its resolution to
+// hold a GPU frame-time target, then stretches the result over the window.
+//
+// The target is allocated at window size once; lower scales render into its
+// lower-left corner, so changing scale never reallocates. GPU time of the
+// scene pass is measured with GL_TIME_ELAPSED queries kept in a small ring and
+// read a few frames late, which never stalls the pipeline.
+class DynamicResolution
+{
+public:
+    float targetMs = 12.0f;  // GPU budget for the scene pass
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    bool enabled = true;
+
+    DynamicResolution(int windowWidth, int windowHeight)
+    {
+        glGenQueries(QUERY_COUNT, m_Queries);
+        Resize(windowWidth, windowHeight);
+    }
+
+    ~DynamicResolution()
+    {
+        ReleaseTarget();
+        glDeleteQueries(QUERY_COUNT, m_Queries);
+    }
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // Called with the framebuffer size; a minimized window (0x0) is ignored
+    void Resize(int windowWidth, int windowHeight)
+    {
+        if (windowWidth <= 0 || windowHeight <= 0)
+            return;
+        if (windowWidth == m_WindowWidth && windowHeight == m_WindowHeight && m_FBO)
+            return;
+        m_WindowWidth = windowWidth;
+        m_WindowHeight = windowHeight;
+
+        ReleaseTarget();
+        glGenFramebuffers(1, &m_FBO);
+        glGenRenderbuffers(1, &m_Color);
+        glGenRenderbuffers(1, &m_Depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_Color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth, windowHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_Depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, windowWidth, windowHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_Color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_Depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::printf("DynamicResolution: offscreen target incomplete, rendering to the window\n");
+            ReleaseTarget();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        m_TargetBytes = (int64_t)windowWidth * windowHeight * 8; // RGBA8 + D24S8
+        if (m_FBO)
+            MemoryStats::TrackGpu(MemTag::RenderTargets, m_TargetBytes);
+        else
+            m_TargetBytes = 0;
+    }
+
+    // Binds the scaled target (or the window when disabled) and starts timing
+    void BeginScene()
+    {
+        m_Active = enabled && m_FBO;
+        if (!m_Queried[m_QueryIndex])
+            glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_QueryIndex]);
+
+        if (m_Active)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+            glViewport(0, 0, GetRenderWidth(), GetRenderHeight());
+        }
+        else
+            glViewport(0, 0, m_WindowWidth, m_WindowHeight);
+    }
+
+    // Stops timing, upscales to the window and adjusts the scale from the
+    // oldest finished query
+    void EndScene()
+    {
+        if (!m_Queried[m_QueryIndex])
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            m_Queried[m_QueryIndex] = true;
+        }
+        m_QueryIndex = (m_QueryIndex + 1) % QUERY_COUNT;
+
+        if (m_Active)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_FBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, GetRenderWidth(), GetRenderHeight(), 0, 0, m_WindowWidth, m_WindowHeight,
+                GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, m_WindowWidth, m_WindowHeight);
+        }
+
+        // The slot about to be reused holds the oldest query
+        if (m_Queried[m_QueryIndex])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(m_Queries[m_QueryIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(m_Queries[m_QueryIndex], GL_QUERY_RESULT, &nanoseconds);
+                m_Queried[m_QueryIndex] = false;
+                UpdateScale(nanoseconds / 1.0e6f);
+            }
+        }
+    }
+
+    float GetScale() const { return enabled ? m_Scale : 1.0f; }
+    float GetGpuMs() const { return m_GpuMs; }
+    int GetRenderWidth() const { return std::max(1, (int)(m_WindowWidth * GetScale())); }
+    int GetRenderHeight() const { return std::max(1, (int)(m_WindowHeight * GetScale())); }
+    float GetAspect() const { return m_WindowHeight > 0 ? (float)m_WindowWidth / (float)m_WindowHeight : 1.0f; }
+
+    void Report() const
+    {
+        std::printf("resolution: %s, scale %.2f (%dx%d of %dx%d), scene GPU %.2f ms / %.2f ms target\n",
+            enabled ? "dynamic" : "fixed", GetScale(), GetRenderWidth(), GetRenderHeight(),
+            m_WindowWidth, m_WindowHeight, m_GpuMs, targetMs);
+    }
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    void UpdateScale(float gpuMs)
+    {
+        m_GpuMs = m_GpuMs > 0.0f ? m_GpuMs * 0.9f + gpuMs * 0.1f : gpuMs;
+        if (!enabled)
+            return;
+
+        // Cost is roughly proportional to pixel count, i.e. scale squared.
+        // Only react outside a dead band so the scale does not oscillate.
+        float ratio = targetMs / std::max(m_GpuMs, 0.01f);
+        if (m_Cooldown > 0)
+        {
+            m_Cooldown--;
+            return;
+        }
+        if (ratio > 0.85f && ratio < 1.15f)
+            return;
+        // 5% steps, then let the smoothed time settle before the next one;
+        // small, spaced changes avoid visible pumping
+        float step = ratio > 1.0f ? 0.05f : -0.05f;
+        m_Scale = std::clamp(m_Scale + step, minScale, maxScale);
+        m_Cooldown = 8;
+    }
+
+    void ReleaseTarget()
+    {
+        if (m_FBO)
+        {
+            glDeleteFramebuffers(1, &m_FBO);
+            glDeleteRenderbuffers(1, &m_Color);
+            glDeleteRenderbuffers(1, &m_Depth);
+            MemoryStats::TrackGpu(MemTag::RenderTargets, -m_TargetBytes);
+        }
+        m_FBO = m_Color = m_Depth = 0;
+        m_TargetBytes = 0;
+    }
+
+    unsigned int m_FBO = 0;
+    unsigned int m_Color = 0;
+    unsigned int m_Depth = 0;
+    int64_t m_TargetBytes = 0;
+    int m_WindowWidth = 0;
+    int m_WindowHeight = 0;
+    bool m_Active = false;
+
+    GLuint m_Queries[QUERY_COUNT] = {};
+    bool m_Queried[QUERY_COUNT] = {};
+    int m_QueryIndex = 0;
+
+    float m_Scale = 1.0f;
+    float m_GpuMs = 0.0f;
+    int m_Cooldown = 0;
+};
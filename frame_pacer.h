@@ -0,0 +1,198 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// How frames are paced and presented
+enum class PresentMode
+{
+    VSync,       // swap interval 1, the driver blocks in SwapBuffers
+    Uncapped,    // swap interval 0, no waiting at all
+    Capped,      // swap interval 0, sleep to a fixed rate (capHz)
+    LowLatency,  // vsync, but input and simulation start as late as possible
+    Count
+};
+
+inline const char* GetPresentModeName(PresentMode mode)
+{
+    static const char* names[] = { "vsync", "uncapped", "capped", "low-latency" };
+    return names[(int)mode];
+}
+
+inline bool ParsePresentMode(const char* text, PresentMode& mode)
+{
+    for (int i = 0; i < (int)PresentMode::Count; ++i)
+    {
+        if (std::strcmp(text, GetPresentModeName((PresentMode)i)) == 0)
+        {
+            mode = (PresentMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sits around the frame: WaitForFrame() before input is polled, Present()
+// instead of glfwSwapBuffers. Measures frame time and input-to-present
+// latency (input polled -> swap returned) for the current mode.
+//
+// Low-latency mode keeps vsync but waits for the GPU after each swap so the
+// swap's return marks the vblank. The next frame then starts at
+// vblank + period - predicted work, so input is sampled as close to the
+// deadline as the recent frame costs allow.
+class FramePacer
+{
+public:
+    double capHz = 60.0;
+
+    explicit FramePacer(GLFWwindow* window)
+        : m_Window(window)
+    {
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* video = monitor ? glfwGetVideoMode(monitor) : nullptr;
+        if (video && video->refreshRate > 0)
+            m_RefreshHz = video->refreshRate;
+        SetMode(PresentMode::VSync);
+    }
+
+    void SetMode(PresentMode mode)
+    {
+        m_Mode = mode;
+        glfwSwapInterval(mode == PresentMode::VSync || mode == PresentMode::LowLatency ? 1 : 0);
+        m_NextFrame = 0.0;
+        m_PredictedWork = 0.0;
+        ResetStats();
+    }
+
+    PresentMode GetMode() const { return m_Mode; }
+
+    void CycleMode()
+    {
+        SetMode((PresentMode)(((int)m_Mode + 1) % (int)PresentMode::Count));
+    }
+
+    // Sleeps until this frame should start, then marks the input sample time
+    void WaitForFrame()
+    {
+        if (m_NextFrame > 0.0)
+        {
+            if (m_Mode == PresentMode::Capped)
+                SleepUntil(m_NextFrame);
+            else if (m_Mode == PresentMode::LowLatency)
+                SleepUntil(m_NextFrame - m_PredictedWork - SAFETY_MARGIN);
+        }
+        m_FrameStart = glfwGetTime();
+    }
+
+    // Swaps and records when the frame actually went out
+    void Present()
+    {
+        double submitted = glfwGetTime();
+        glfwSwapBuffers(m_Window);
+        if (m_Mode == PresentMode::LowLatency)
+            glFinish(); // returns once the frame is out, pinning the vblank phase
+        double presented = glfwGetTime();
+
+        if (m_Mode == PresentMode::Capped)
+        {
+            double period = 1.0 / capHz;
+            m_NextFrame = m_NextFrame > 0.0 ? m_NextFrame + period : presented + period;
+            if (m_NextFrame < presented - period)
+                m_NextFrame = presented; // fell too far behind: resync instead of bursting
+        }
+        else if (m_Mode == PresentMode::LowLatency)
+        {
+            // CPU work before the swap decides how early the next frame must
+            // start: jump up to a slow frame at once, decay slowly
+            double period = 1.0 / m_RefreshHz;
+            m_PredictedWork = std::min(std::max(submitted - m_FrameStart, m_PredictedWork * 0.95), period);
+            m_NextFrame = presented + period;
+        }
+
+        if (m_LastPresent > 0.0)
+            Record(m_FrameTimes, (presented - m_LastPresent) * 1000.0);
+        Record(m_Latencies, (presented - m_FrameStart) * 1000.0);
+        m_LastPresent = presented;
+    }
+
+    void Report() const
+    {
+        double frameMean, frameDev, frameMax, latencyMean, latencyDev, latencyMax;
+        Summarize(m_FrameTimes, frameMean, frameDev, frameMax);
+        Summarize(m_Latencies, latencyMean, latencyDev, latencyMax);
+        std::printf("present %-11s frame %6.2f ms (sd %5.2f, max %6.2f)  latency %6.2f ms (sd %5.2f, max %6.2f)\n",
+            GetPresentModeName(m_Mode), frameMean, frameDev, frameMax, latencyMean, latencyDev, latencyMax);
+    }
+
+private:
+    static const int HISTORY = 240;
+    static constexpr double SPIN_MARGIN = 0.002;   // last stretch of a wait is spun, sleep is too coarse
+    static constexpr double SAFETY_MARGIN = 0.002;  // GPU time and jitter not covered by the prediction
+
+    struct History
+    {
+        double samples[HISTORY];
+        int count = 0;
+        int next = 0;
+    };
+
+    // Sleeps most of the way and spins the rest, so the wake-up is accurate
+    // to well under a millisecond without burning a core for the whole wait
+    static void SleepUntil(double target)
+    {
+        double now = glfwGetTime();
+        if (target - now > SPIN_MARGIN)
+            std::this_thread::sleep_for(std::chrono::duration<double>(target - now - SPIN_MARGIN));
+        while (glfwGetTime() < target)
+            std::this_thread::yield();
+    }
+
+    static void Record(History& history, double value)
+    {
+        history.samples[history.next] = value;
+        history.next = (history.next + 1) % HISTORY;
+        history.count = std::min(history.count + 1, HISTORY);
+    }
+
+    static void Summarize(const History& history, double& mean, double& deviation, double& maximum)
+    {
+        mean = deviation = maximum = 0.0;
+        if (history.count == 0)
+            return;
+        for (int i = 0; i < history.count; ++i)
+        {
+            mean += history.samples[i];
+            maximum = std::max(maximum, history.samples[i]);
+        }
+        mean /= history.count;
+        for (int i = 0; i < history.count; ++i)
+            deviation += (history.samples[i] - mean) * (history.samples[i] - mean);
+        deviation = std::sqrt(deviation / history.count);
+    }
+
+    void ResetStats()
+    {
+        m_FrameTimes.count = m_FrameTimes.next = 0;
+        m_Latencies.count = m_Latencies.next = 0;
+        m_LastPresent = 0.0;
+    }
+
+    GLFWwindow* m_Window;
+    PresentMode m_Mode = PresentMode::VSync;
+    double m_RefreshHz = 60.0;
+
+    double m_FrameStart = 0.0;
+    double m_LastPresent = 0.0;
+    double m_NextFrame = 0.0;
+    double m_PredictedWork = 0.0;
+
+    History m_FrameTimes;
+    History m_Latencies;
+};
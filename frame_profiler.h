@@ -0,0 +1,295 @@
+#pragma once
+
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Per-frame cost of each animation stage. ProfileScope adds wall time and,
+// when enabled, hardware counter deltas (perf_counters.h) to the stage;
+// EndFrame() latches the totals into a ring of recent frames that Report()
+// averages and ExportCsv() writes out one row per frame and stage.
+//
+// Scopes may run on any thread: counters are opened per thread on first use,
+// and each thread adds to totals of its own that EndFrame() folds together,
+// so job workers profiling in parallel never write a shared cache line.
+enum class ProfileStage
+{
+    Sampling,   // keyframe search + interpolation into local transforms
+    Hierarchy,  // local -> model space, parent before child
+    Skinning,   // model space * offset into the palette, plus sockets
+    Count
+};
+
+namespace FrameProfiler
+{
+    const int STAGE_COUNT = (int)ProfileStage::Count;
+    const int HISTORY = 600;
+
+    inline const char* GetStageName(int stage)
+    {
+        static const char* names[] = { "sampling", "hierarchy", "skinning" };
+        return names[stage];
+    }
+
+    struct FrameRecord
+    {
+        double frameMs;
+        uint64_t nanoseconds[STAGE_COUNT];
+        uint64_t calls[STAGE_COUNT];
+        uint64_t counters[STAGE_COUNT][PERF_COUNTER_COUNT];
+    };
+
+    // Running totals of one thread. Only that thread writes them (a load and
+    // a store, no locked add) and they only grow; `seen` is what EndFrame
+    // last folded in, so it takes the difference instead of resetting them.
+    struct alignas(64) ThreadTotals
+    {
+        std::atomic<uint64_t> nanoseconds[STAGE_COUNT] = {};
+        std::atomic<uint64_t> calls[STAGE_COUNT] = {};
+        std::atomic<uint64_t> counters[STAGE_COUNT][PERF_COUNTER_COUNT] = {};
+        alignas(64) FrameRecord seen = {};
+        bool inUse = false;
+    };
+
+    inline bool enabled = true;
+    inline std::atomic<bool> countersEnabled{ false };
+    // Blocks outlive their threads and go to the next thread that starts
+    // profiling, so worker pools created per run do not pile them up
+    inline std::mutex threadsMutex;
+    inline std::vector<std::unique_ptr<ThreadTotals>> threadTotals;
+    inline FrameRecord history[HISTORY];
+    inline int historyCount = 0;
+    inline int historyNext = 0;
+
+    // Opened once per thread; stays closed when perf is unavailable
+    inline PerfCounterGroup& GetThreadCounters()
+    {
+        thread_local PerfCounterGroup group;
+        thread_local bool tried = false;
+        if (!tried)
+        {
+            tried = true;
+            group.Open();
+        }
+        return group;
+    }
+
+    inline ThreadTotals& GetThreadTotals()
+    {
+        struct Slot
+        {
+            ThreadTotals* totals = nullptr;
+            ~Slot()
+            {
+                if (!totals)
+                    return;
+                std::lock_guard<std::mutex> lock(threadsMutex);
+                totals->inUse = false;
+            }
+        };
+        thread_local Slot slot;
+        if (!slot.totals)
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            for (size_t i = 0; i < threadTotals.size() && !slot.totals; ++i)
+                if (!threadTotals[i]->inUse)
+                    slot.totals = threadTotals[i].get();
+            if (!slot.totals)
+            {
+                threadTotals.push_back(std::make_unique<ThreadTotals>());
+                slot.totals = threadTotals.back().get();
+            }
+            slot.totals->inUse = true;
+        }
+        return *slot.totals;
+    }
+
+    // Adds to `record` (when given) what every thread counted since the last
+    // fold. Runs between frames, once the workers are done with the frame.
+    inline void FoldThreadTotals(FrameRecord* record)
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (const std::unique_ptr<ThreadTotals>& totals : threadTotals)
+        {
+            FrameRecord& seen = totals->seen;
+            for (int s = 0; s < STAGE_COUNT; ++s)
+            {
+                uint64_t ns = totals->nanoseconds[s].load(std::memory_order_relaxed);
+                uint64_t calls = totals->calls[s].load(std::memory_order_relaxed);
+                if (record)
+                {
+                    record->nanoseconds[s] += ns - seen.nanoseconds[s];
+                    record->calls[s] += calls - seen.calls[s];
+                }
+                seen.nanoseconds[s] = ns;
+                seen.calls[s] = calls;
+                for (int c = 0; c < PERF_COUNTER_COUNT; ++c)
+                {
+                    uint64_t value = totals->counters[s][c].load(std::memory_order_relaxed);
+                    if (record)
+                        record->counters[s][c] += value - seen.counters[s][c];
+                    seen.counters[s][c] = value;
+                }
+            }
+        }
+    }
+
+    // Probes perf on the calling thread; false (and counters stay off) if
+    // the kernel refuses, e.g. because of kernel.perf_event_paranoid
+    inline bool EnableCounters()
+    {
+        bool ok = GetThreadCounters().IsOpen();
+        if (!ok)
+            std::printf("FrameProfiler: perf_event_open unavailable, wall times only\n");
+        countersEnabled = ok;
+        return ok;
+    }
+
+    inline void EndFrame(double frameMs)
+    {
+        FrameRecord& record = history[historyNext];
+        record = FrameRecord();
+        record.frameMs = frameMs;
+        FoldThreadTotals(&record);
+        historyNext = (historyNext + 1) % HISTORY;
+        historyCount = std::min(historyCount + 1, HISTORY);
+    }
+
+    // Drops the recorded history (and anything counted since the last frame)
+    inline void Reset()
+    {
+        FoldThreadTotals(nullptr);
+        historyCount = 0;
+        historyNext = 0;
+    }
+
+    // Mean milliseconds per recorded frame spent in a stage
+    inline double GetAverageMs(int stage)
+    {
+        if (historyCount == 0)
+            return 0.0;
+        double ns = 0.0;
+        for (int f = 0; f < historyCount; ++f)
+            ns += (double)history[f].nanoseconds[stage];
+        return ns / historyCount / 1.0e6;
+    }
+
+    // Mean count of a hardware counter per recorded frame in a stage (0 when
+    // counters are off or the event is not available)
+    inline double GetAverageCounter(int stage, int counter)
+    {
+        if (historyCount == 0)
+            return 0.0;
+        double total = 0.0;
+        for (int f = 0; f < historyCount; ++f)
+            total += (double)history[f].counters[stage][counter];
+        return total / historyCount;
+    }
+
+    // Averages per frame over the recorded history
+    inline void Report()
+    {
+        if (historyCount == 0)
+            return;
+        std::printf("%-10s %8s %7s %12s %12s %6s %10s %10s %10s   (per frame, %d frames)\n", "stage", "ms", "calls",
+            "cycles", "instr", "IPC", "LLC miss", "br miss", "dTLB miss", historyCount);
+        for (int s = 0; s < STAGE_COUNT; ++s)
+        {
+            double ns = 0.0, calls = 0.0, counters[PERF_COUNTER_COUNT] = {};
+            for (int f = 0; f < historyCount; ++f)
+            {
+                ns += (double)history[f].nanoseconds[s];
+                calls += (double)history[f].calls[s];
+                for (int c = 0; c < PERF_COUNTER_COUNT; ++c)
+                    counters[c] += (double)history[f].counters[s][c];
+            }
+            double ipc = counters[PERF_CYCLES] > 0.0 ? counters[PERF_INSTRUCTIONS] / counters[PERF_CYCLES] : 0.0;
+            std::printf("%-10s %8.3f %7.1f %12.0f %12.0f %6.2f %10.0f %10.0f %10.0f\n", GetStageName(s),
+                ns / historyCount / 1.0e6, calls / historyCount, counters[PERF_CYCLES] / historyCount,
+                counters[PERF_INSTRUCTIONS] / historyCount, ipc, counters[PERF_LLC_MISSES] / historyCount,
+                counters[PERF_BRANCH_MISSES] / historyCount, counters[PERF_DTLB_MISSES] / historyCount);
+        }
+    }
+
+    // One row per recorded frame and stage, oldest first
+    inline bool ExportCsv(const char* path)
+    {
+        FILE* file = std::fopen(path, "w");
+        if (!file)
+            return false;
+        std::fprintf(file, "frame,frame_ms,stage,stage_ms,calls");
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c)
+            std::fprintf(file, ",%s", GetPerfCounterName(c));
+        std::fprintf(file, "\n");
+
+        int first = historyCount < HISTORY ? 0 : historyNext;
+        for (int f = 0; f < historyCount; ++f)
+        {
+            const FrameRecord& record = history[(first + f) % HISTORY];
+            for (int s = 0; s < STAGE_COUNT; ++s)
+            {
+                std::fprintf(file, "%d,%.4f,%s,%.4f,%llu", f, record.frameMs, GetStageName(s),
+                    record.nanoseconds[s] / 1.0e6, (unsigned long long)record.calls[s]);
+                for (int c = 0; c < PERF_COUNTER_COUNT; ++c)
+                    std::fprintf(file, ",%llu", (unsigned long long)record.counters[s][c]);
+                std::fprintf(file, "\n");
+            }
+        }
+        std::fclose(file);
+        return true;
+    }
+}
+
+// Charges the enclosing block to a stage
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileStage stage)
+        : m_Stage((int)stage)
+    {
+        m_Active = FrameProfiler::enabled;
+        if (!m_Active)
+            return;
+        m_Counters = FrameProfiler::countersEnabled.load(std::memory_order_relaxed)
+            && FrameProfiler::GetThreadCounters().Read(m_Start);
+        m_StartTime = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileScope()
+    {
+        if (!m_Active)
+            return;
+        auto elapsed = std::chrono::steady_clock::now() - m_StartTime;
+        FrameProfiler::ThreadTotals& totals = FrameProfiler::GetThreadTotals();
+        Add(totals.nanoseconds[m_Stage], (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        Add(totals.calls[m_Stage], 1);
+
+        PerfSample end;
+        if (m_Counters && FrameProfiler::GetThreadCounters().Read(end))
+            for (int c = 0; c < PERF_COUNTER_COUNT; ++c)
+                Add(totals.counters[m_Stage][c], end.values[c] - m_Start.values[c]);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    // This thread is the only writer
+    static void Add(std::atomic<uint64_t>& total, uint64_t value)
+    {
+        total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    int m_Stage;
+    bool m_Active;
+    bool m_Counters = false;
+    PerfSample m_Start;
+    std::chrono::steady_clock::time_point m_StartTime;
+};
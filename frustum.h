@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// View frustum planes pulled out of a view-projection matrix (Gribb/Hartmann)
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        // glm is column-major, so row r of the matrix is m[c][r]
+        for (int i = 0; i < 6; ++i)
+        {
+            int row = i / 2;
+            float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+            for (int c = 0; c < 4; ++c)
+                planes[i][c] = viewProjection[c][3] + sign * viewProjection[c][row];
+            planes[i] = planes[i] / glm::length(glm::vec3(planes[i].x, planes[i].y, planes[i].z));
+        }
+    }
+
+    bool IsSphereVisible(const glm::vec3& center, float radius) const
+    {
+        for (int i = 0; i < 6; ++i)
+            if (glm::dot(glm::vec3(planes[i].x, planes[i].y, planes[i].z), center) + planes[i].w < -radius)
+                return false;
+        return true;
+    }
+};
@@ -0,0 +1,536 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <learnopengl/model_animation.h>
+
+#include "anim_clip.h"
+#include "json.h"
+#include "skinned_model.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Binary glTF 2.0 (.glb) reader. Accessors are copied straight from the BIN
+// chunk into Vertex/index/keyframe arrays; the only intermediate structure is
+// the (small) JSON header.
+class GltfLoader
+{
+public:
+    static SkinnedModel* LoadModel(const std::string& path)
+    {
+        GltfLoader gltf;
+        if (!gltf.Open(path))
+            return nullptr;
+
+        SkinnedModel* model = new SkinnedModel();
+        model->directory = path.substr(0, path.find_last_of("/\\"));
+        // An index that points outside its table rejects the whole file
+        auto reject = [&](const char* reason) {
+            gltf.Fail(path, reason);
+            delete model;
+            return (SkinnedModel*)nullptr;
+        };
+
+        // Mesh -> skin, taken from the first node that instantiates the mesh
+        const JsonValue& nodes = gltf.m_Json["nodes"];
+        const JsonValue& skins = gltf.m_Json["skins"];
+        std::vector<int> meshSkin(gltf.m_Json["meshes"].Size(), -1);
+        for (size_t n = 0; n < nodes.Size(); ++n)
+        {
+            if (!nodes[n].Has("mesh") || !nodes[n].Has("skin"))
+                continue;
+            int mesh = nodes[n]["mesh"].AsInt(-1);
+            int skin = nodes[n]["skin"].AsInt(-1);
+            if (mesh < 0 || mesh >= (int)meshSkin.size() || skin < 0 || skin >= (int)skins.Size())
+                return reject("node mesh or skin index out of range");
+            meshSkin[mesh] = skin;
+        }
+
+        // Joint slot within a skin -> palette slot of the model
+        std::vector<std::vector<int>> skinBones(skins.Size());
+        for (size_t s = 0; s < skins.Size(); ++s)
+        {
+            const JsonValue& joints = skins[s]["joints"];
+            std::vector<float> inverseBind;
+            if (skins[s].Has("inverseBindMatrices") && !gltf.ReadFloats(skins[s]["inverseBindMatrices"].AsInt(-1), 16, inverseBind))
+                return reject("bad inverseBindMatrices accessor");
+            for (size_t j = 0; j < joints.Size(); ++j)
+            {
+                int joint = joints[j].AsInt(-1);
+                if (joint < 0 || joint >= (int)nodes.Size())
+                    return reject("skin joint out of range");
+                glm::mat4 offset = inverseBind.size() >= (j + 1) * 16 ? glm::make_mat4(&inverseBind[j * 16]) : glm::mat4(1.0f);
+                const std::string& name = nodes[(size_t)joint]["name"].AsString();
+                skinBones[s].push_back(model->AddBone(name, offset));
+            }
+        }
+
+        const JsonValue& meshes = gltf.m_Json["meshes"];
+        std::vector<float> positions, normals, texCoords, weights;
+        std::vector<uint32_t> joints;
+        for (size_t m = 0; m < meshes.Size(); ++m)
+        {
+            const JsonValue& primitives = meshes[m]["primitives"];
+            for (size_t p = 0; p < primitives.Size(); ++p)
+            {
+                const JsonValue& primitive = primitives[p];
+                if (primitive["mode"].AsInt(4) != 4)
+                    continue; // triangles only, like aiProcess_Triangulate output
+
+                const JsonValue& attributes = primitive["attributes"];
+                if (!attributes.Has("POSITION"))
+                    continue;
+                if (!gltf.ReadFloats(attributes["POSITION"].AsInt(-1), 3, positions))
+                    return reject("bad POSITION accessor");
+                size_t count = positions.size() / 3;
+                if ((attributes.Has("NORMAL") && !gltf.ReadFloats(attributes["NORMAL"].AsInt(-1), 3, normals))
+                    || (attributes.Has("TEXCOORD_0") && !gltf.ReadFloats(attributes["TEXCOORD_0"].AsInt(-1), 2, texCoords))
+                    || (attributes.Has("WEIGHTS_0") && !gltf.ReadFloats(attributes["WEIGHTS_0"].AsInt(-1), 4, weights))
+                    || (attributes.Has("JOINTS_0") && !gltf.ReadUInts(attributes["JOINTS_0"].AsInt(-1), joints)))
+                    return reject("bad vertex attribute accessor");
+                if (!attributes.Has("NORMAL"))
+                    normals.clear();
+                if (!attributes.Has("TEXCOORD_0"))
+                    texCoords.clear();
+                if (!attributes.Has("WEIGHTS_0"))
+                    weights.clear();
+                if (!attributes.Has("JOINTS_0"))
+                    joints.clear();
+                const std::vector<int>* bones = meshSkin[m] >= 0 ? &skinBones[meshSkin[m]] : nullptr;
+
+                bool skinned = bones && joints.size() >= count * 4 && weights.size() >= count * 4;
+                if (skinned)
+                    for (size_t i = 0; i < count * 4; ++i)
+                        if (weights[i] > 0.0f && joints[i] >= bones->size())
+                            return reject("JOINTS_0 value outside the skin");
+
+                std::vector<Vertex> vertices(count);
+                for (size_t v = 0; v < count; ++v)
+                {
+                    Vertex& vertex = vertices[v];
+                    vertex.Position = glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+                    vertex.Normal = normals.size() >= count * 3
+                        ? glm::vec3(normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2]) : glm::vec3(0.0f);
+                    // glTF puts the UV origin top-left; textures are loaded flipped
+                    vertex.TexCoords = texCoords.size() >= count * 2
+                        ? glm::vec2(texCoords[v * 2], 1.0f - texCoords[v * 2 + 1]) : glm::vec2(0.0f);
+                    vertex.Tangent = glm::vec3(0.0f);
+                    vertex.Bitangent = glm::vec3(0.0f);
+                    for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+                    {
+                        vertex.m_BoneIDs[i] = -1;
+                        vertex.m_Weights[i] = 0.0f;
+                        if (!skinned)
+                            continue;
+                        float weight = weights[v * 4 + i];
+                        uint32_t joint = joints[v * 4 + i];
+                        if (weight > 0.0f)
+                        {
+                            vertex.m_BoneIDs[i] = (*bones)[joint];
+                            vertex.m_Weights[i] = weight;
+                        }
+                    }
+                }
+
+                std::vector<unsigned int> indices;
+                if (primitive.Has("indices"))
+                {
+                    if (!gltf.ReadUInts(primitive["indices"].AsInt(-1), indices))
+                        return reject("bad indices accessor");
+                    for (unsigned int index : indices)
+                        if (index >= count)
+                            return reject("vertex index out of range");
+                }
+                else
+                    for (size_t v = 0; v < count; ++v)
+                        indices.push_back((unsigned int)v);
+
+                std::vector<Texture> textures;
+                gltf.LoadMaterialTextures(primitive["material"].AsInt(-1), *model, textures);
+                model->AddMesh(vertices, indices, textures);
+            }
+        }
+        model->Upload();
+        return model;
+    }
+
+    static AnimClip* LoadClip(const std::string& path, SkinnedModel* model, int animationIndex = 0)
+    {
+        GltfLoader gltf;
+        if (!gltf.Open(path))
+            return nullptr;
+
+        const JsonValue& animation = gltf.m_Json["animations"][(size_t)animationIndex];
+        if (animation.IsNull())
+        {
+            std::cout << "GLTF: no animation " << animationIndex << " in " << path << std::endl;
+            return nullptr;
+        }
+
+        AnimClip* clip = new AnimClip();
+        clip->m_TicksPerSecond = 1.0f; // glTF keys are in seconds
+        auto reject = [&](const char* reason) {
+            gltf.Fail(path, reason);
+            delete clip;
+            return (AnimClip*)nullptr;
+        };
+
+        // Hierarchy from the scene roots
+        const JsonValue& nodes = gltf.m_Json["nodes"];
+        const JsonValue& scene = gltf.m_Json["scenes"][(size_t)gltf.m_Json["scene"].AsInt(0)];
+        for (size_t r = 0; r < scene["nodes"].Size(); ++r)
+            if (!gltf.ReadHierarchy(scene["nodes"][r].AsInt(-1), -1, clip->m_Nodes))
+                return reject("node hierarchy out of range or cyclic");
+
+        // One track per animated node, merging its T/R/S channels
+        std::vector<int> nodeTrack(nodes.Size(), -1);
+        const JsonValue& channels = animation["channels"];
+        const JsonValue& samplers = animation["samplers"];
+        std::vector<float> times, values;
+        for (size_t c = 0; c < channels.Size(); ++c)
+        {
+            const JsonValue& target = channels[c]["target"];
+            int node = target["node"].AsInt(-1);
+            int samplerIndex = channels[c]["sampler"].AsInt(-1);
+            const std::string& property = target["path"].AsString();
+            if (node < 0 || node >= (int)nodes.Size() || samplerIndex < 0 || samplerIndex >= (int)samplers.Size())
+                return reject("channel node or sampler out of range");
+            const JsonValue& sampler = samplers[(size_t)samplerIndex];
+
+            int components = property == "rotation" ? 4 : 3;
+            if (property != "translation" && property != "rotation" && property != "scale")
+                continue; // morph weights
+            if (!gltf.ReadFloats(sampler["input"].AsInt(-1), 1, times) ||
+                !gltf.ReadFloats(sampler["output"].AsInt(-1), components, values))
+                return reject("bad sampler accessor");
+
+            if (nodeTrack[node] < 0)
+            {
+                nodeTrack[node] = (int)clip->m_Tracks.size();
+                clip->m_Tracks.emplace_back();
+                clip->m_Tracks.back().nodeName = nodes[(size_t)node]["name"].AsString();
+            }
+            ClipTrack& track = clip->m_Tracks[nodeTrack[node]];
+
+            // Cubic spline outputs are (in-tangent, value, out-tangent); keep the values
+            bool cubic = sampler["interpolation"].AsString() == "CUBICSPLINE";
+            size_t stride = cubic ? 3 : 1;
+            size_t offset = cubic ? 1 : 0;
+            for (size_t k = 0; k < times.size() && (k * stride + offset + 1) * components <= values.size(); ++k)
+            {
+                const float* v = &values[(k * stride + offset) * components];
+                if (property == "translation")
+                {
+                    track.positionTimes.push_back(times[k]);
+                    track.positions.push_back(glm::vec3(v[0], v[1], v[2]));
+                }
+                else if (property == "rotation")
+                {
+                    track.rotationTimes.push_back(times[k]);
+                    track.rotations.push_back(glm::quat(v[3], v[0], v[1], v[2]));
+                }
+                else
+                {
+                    track.scaleTimes.push_back(times[k]);
+                    track.scales.push_back(glm::vec3(v[0], v[1], v[2]));
+                }
+            }
+            if (!times.empty())
+                clip->m_Duration = std::max(clip->m_Duration, times.back());
+        }
+
+        clip->AddMissingBones(model);
+        return clip;
+    }
+
+private:
+    bool Open(const std::string& path)
+    {
+        // Parse straight from the load set's buffer when the file was preloaded
+        if (const AsyncIO::FileData* preloaded = AsyncIO::FindPreloaded(path))
+        {
+            m_Data = (const char*)preloaded->data;
+            m_Size = preloaded->size;
+        }
+        else
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file)
+                return false;
+            m_File.resize((size_t)file.tellg());
+            file.seekg(0);
+            file.read(m_File.data(), (std::streamsize)m_File.size());
+            m_Data = m_File.data();
+            m_Size = m_File.size();
+        }
+
+        struct Header { uint32_t magic, version, length; };
+        struct ChunkHeader { uint32_t length, type; };
+        const uint32_t GLB_MAGIC = 0x46546C67;  // "glTF"
+        const uint32_t CHUNK_JSON = 0x4E4F534A;
+        const uint32_t CHUNK_BIN = 0x004E4942;
+
+        Header header;
+        if (m_Size < sizeof(Header) + sizeof(ChunkHeader))
+            return Fail(path, "file too small");
+        std::memcpy(&header, m_Data, sizeof(header));
+        if (header.magic != GLB_MAGIC || header.version != 2)
+            return Fail(path, "not a glTF 2.0 binary");
+
+        size_t offset = sizeof(Header);
+        while (offset + sizeof(ChunkHeader) <= m_Size)
+        {
+            ChunkHeader chunk;
+            std::memcpy(&chunk, m_Data + offset, sizeof(chunk));
+            offset += sizeof(ChunkHeader);
+            if (offset + chunk.length > m_Size)
+                return Fail(path, "truncated chunk");
+            if (chunk.type == CHUNK_JSON)
+            {
+                bool ok = false;
+                m_Json = JsonValue::Parse(m_Data + offset, chunk.length, &ok);
+                if (!ok)
+                    return Fail(path, "bad JSON chunk");
+            }
+            else if (chunk.type == CHUNK_BIN && !m_Bin)
+            {
+                m_Bin = (const uint8_t*)m_Data + offset;
+                m_BinSize = chunk.length;
+            }
+            offset += (chunk.length + 3) & ~3u;
+        }
+        if (m_Json.IsNull())
+            return Fail(path, "missing JSON chunk");
+        return true;
+    }
+
+    bool Fail(const std::string& path, const char* reason)
+    {
+        std::cout << "GLTF: " << path << ": " << reason << std::endl;
+        return false;
+    }
+
+    static int GetComponentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case 5120: case 5121: return 1;   // (u)byte
+        case 5122: case 5123: return 2;   // (u)short
+        case 5125: case 5126: return 4;   // uint, float
+        default: return 0;
+        }
+    }
+
+    // Resolves an accessor to a pointer into the BIN chunk. Returns false for
+    // sparse accessors and out-of-range views, which our exporter never writes.
+    bool GetAccessor(int index, int components, const uint8_t*& data, size_t& count, size_t& stride, int& componentType) const
+    {
+        const JsonValue& accessor = m_Json["accessors"][(size_t)index];
+        if (index < 0 || accessor.IsNull() || accessor.Has("sparse") || !accessor.Has("bufferView"))
+            return false;
+        const JsonValue& view = m_Json["bufferViews"][(size_t)accessor["bufferView"].AsInt()];
+        if (view["buffer"].AsInt(0) != 0 || !m_Bin)
+            return false;
+
+        componentType = accessor["componentType"].AsInt();
+        int componentSize = GetComponentSize(componentType);
+        if (componentSize == 0)
+            return false;
+        // Each value is a non-negative int, so the sums below cannot wrap in 64 bits
+        int countValue = accessor["count"].AsInt(-1);
+        int strideValue = view["byteStride"].AsInt(components * componentSize);
+        int viewOffset = view["byteOffset"].AsInt(0);
+        int viewLength = view["byteLength"].AsInt(-1);
+        int accessorOffset = accessor["byteOffset"].AsInt(0);
+        if (countValue < 0 || strideValue <= 0 || viewOffset < 0 || viewLength < 0 || accessorOffset < 0)
+            return false;
+        count = (size_t)countValue;
+        stride = (size_t)strideValue;
+        uint64_t needed = count ? (uint64_t)(count - 1) * stride + (uint64_t)components * componentSize : 0;
+        if ((uint64_t)accessorOffset + needed > (uint64_t)viewLength || (uint64_t)viewOffset + viewLength > m_BinSize)
+            return false;
+        data = m_Bin + viewOffset + accessorOffset;
+        return true;
+    }
+
+    bool ReadFloats(int accessorIndex, int components, std::vector<float>& out) const
+    {
+        out.clear();
+        const uint8_t* data;
+        size_t count, stride;
+        int type;
+        if (!GetAccessor(accessorIndex, components, data, count, stride, type))
+            return false;
+
+        out.resize(count * components);
+        bool normalized = m_Json["accessors"][(size_t)accessorIndex]["normalized"].boolean;
+        for (size_t i = 0; i < count; ++i, data += stride)
+        {
+            float* dst = &out[i * components];
+            if (type == 5126)
+            {
+                std::memcpy(dst, data, sizeof(float) * components);
+                continue;
+            }
+            for (int c = 0; c < components; ++c)
+            {
+                if (type == 5121)
+                    dst[c] = data[c] / (normalized ? 255.0f : 1.0f);
+                else if (type == 5123)
+                {
+                    uint16_t v;
+                    std::memcpy(&v, data + c * 2, 2);
+                    dst[c] = v / (normalized ? 65535.0f : 1.0f);
+                }
+                else
+                    dst[c] = 0.0f;
+            }
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool ReadUInts(int accessorIndex, std::vector<T>& out) const
+    {
+        out.clear();
+        const uint8_t* data;
+        size_t count, stride;
+        int type;
+        const JsonValue& accessor = m_Json["accessors"][(size_t)accessorIndex];
+        const std::string& shape = accessor["type"].AsString();
+        int components = shape == "VEC4" ? 4 : shape == "VEC3" ? 3 : shape == "VEC2" ? 2 : 1;
+        if (!GetAccessor(accessorIndex, components, data, count, stride, type))
+            return false;
+
+        out.resize(count * components);
+        int size = GetComponentSize(type);
+        for (size_t i = 0; i < count; ++i, data += stride)
+        {
+            for (int c = 0; c < components; ++c)
+            {
+                uint32_t v = 0;
+                if (size == 1)
+                    v = data[c];
+                else if (size == 2)
+                {
+                    uint16_t s;
+                    std::memcpy(&s, data + c * 2, 2);
+                    v = s;
+                }
+                else
+                    std::memcpy(&v, data + c * 4, 4);
+                out[i * components + c] = (T)v;
+            }
+        }
+        return true;
+    }
+
+    static glm::mat4 ReadNodeTransform(const JsonValue& node)
+    {
+        const JsonValue& matrix = node["matrix"];
+        if (matrix.Size() == 16)
+        {
+            float m[16];
+            for (int i = 0; i < 16; ++i)
+                m[i] = matrix[(size_t)i].AsFloat();
+            return glm::make_mat4(m);
+        }
+        const JsonValue& t = node["translation"];
+        const JsonValue& r = node["rotation"];
+        const JsonValue& s = node["scale"];
+        glm::vec3 translation(t[(size_t)0].AsFloat(0.0f), t[1].AsFloat(0.0f), t[2].AsFloat(0.0f));
+        glm::quat rotation(r[3].AsFloat(1.0f), r[(size_t)0].AsFloat(0.0f), r[1].AsFloat(0.0f), r[2].AsFloat(0.0f));
+        glm::vec3 scale(s[(size_t)0].AsFloat(1.0f), s[1].AsFloat(1.0f), s[2].AsFloat(1.0f));
+        return glm::translate(glm::mat4(1.0f), translation) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    }
+
+    // False for a child index outside the node table, or when the walk
+    // visits more nodes than there are (a cycle)
+    bool ReadHierarchy(int index, int parent, std::vector<ClipNode>& out) const
+    {
+        const JsonValue& nodes = m_Json["nodes"];
+        if (index < 0 || index >= (int)nodes.Size() || out.size() >= nodes.Size())
+            return false;
+        const JsonValue& node = nodes[(size_t)index];
+        int self = (int)out.size();
+        out.push_back({ node["name"].AsString(), parent, ReadNodeTransform(node) });
+        const JsonValue& children = node["children"];
+        for (size_t c = 0; c < children.Size(); ++c)
+            if (!ReadHierarchy(children[c].AsInt(-1), self, out))
+                return false;
+        return true;
+    }
+
+    void LoadMaterialTextures(int materialIndex, SkinnedModel& model, std::vector<Texture>& out) const
+    {
+        const JsonValue& material = m_Json["materials"][(size_t)materialIndex];
+        const JsonValue& baseColor = material["pbrMetallicRoughness"]["baseColorTexture"];
+        if (materialIndex < 0 || baseColor.IsNull())
+            return;
+        int imageIndex = m_Json["textures"][(size_t)baseColor["index"].AsInt()]["source"].AsInt(-1);
+        const JsonValue& image = m_Json["images"][(size_t)imageIndex];
+        if (image.IsNull())
+            return;
+
+        // Same de-duplication key scheme as Model::loadMaterialTextures
+        std::string key = image.Has("uri") ? image["uri"].AsString() : "glb:image" + std::to_string(imageIndex);
+        for (const Texture& loaded : model.textures_loaded)
+        {
+            if (loaded.path == key)
+            {
+                out.push_back(loaded);
+                return;
+            }
+        }
+
+        Texture texture;
+        texture.type = "texture_diffuse";
+        texture.path = key;
+        if (image.Has("uri"))
+            texture.id = TextureFromFile(key.c_str(), model.directory);
+        else
+        {
+            const JsonValue& view = m_Json["bufferViews"][(size_t)image["bufferView"].AsInt()];
+            int offset = view["byteOffset"].AsInt(-1);
+            int length = view["byteLength"].AsInt(-1);
+            if (!m_Bin || offset < 0 || length < 0 || (uint64_t)offset + length > m_BinSize)
+                return;
+            texture.id = TextureFromMemory(m_Bin + offset, (int)length);
+        }
+        if (texture.id == 0)
+            return;
+        model.textures_loaded.push_back(texture);
+        out.push_back(texture);
+    }
+
+    // TextureFromFile for images embedded in the BIN chunk
+    static unsigned int TextureFromMemory(const uint8_t* bytes, int length)
+    {
+        int width, height, nrComponents;
+        unsigned char* data = stbi_load_from_memory(bytes, length, &width, &height, &nrComponents, 0);
+        if (!data)
+        {
+            std::cout << "GLTF: failed to decode embedded texture" << std::endl;
+            return 0;
+        }
+        unsigned int textureID = UploadTexture(data, width, height, nrComponents);
+        stbi_image_free(data);
+        return textureID;
+    }
+
+    std::vector<char> m_File; // owned copy when not preloaded
+    const char* m_Data = nullptr;
+    size_t m_Size = 0;
+    JsonValue m_Json;
+    const uint8_t* m_Bin = nullptr;
+    size_t m_BinSize = 0;
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Epoch-based reclamation for objects that readers reach without locks.
+//
+// A reader brackets its work with an EpochScope (the main loop holds one for
+// the whole frame; job workers run inside the frame that submitted them).
+// Retire() does not free: it stamps the object with the current epoch, and
+// Advance() (once per frame, outside any scope) frees everything retired
+// before the oldest epoch a reader is still in. So a pointer resolved during
+// a frame stays valid until that frame is over, even if the asset was
+// replaced or released meanwhile.
+namespace Epoch
+{
+    const int MAX_THREADS = 64;
+    const uint64_t INACTIVE = 0;
+
+    struct alignas(64) Participant
+    {
+        std::atomic<uint64_t> epoch{ INACTIVE };
+        std::atomic<bool> claimed{ false };
+    };
+
+    struct Retired
+    {
+        void* object;
+        void (*destroy)(void*);
+        uint64_t epoch;
+    };
+
+    inline std::atomic<uint64_t> globalEpoch{ 1 };
+    inline Participant participants[MAX_THREADS];
+    inline std::mutex retiredMutex;
+    inline std::vector<Retired> retired;
+
+    // Claimed on a thread's first scope and kept for the thread's lifetime
+    inline Participant& GetParticipant()
+    {
+        thread_local Participant* participant = nullptr;
+        if (!participant)
+        {
+            for (Participant& candidate : participants)
+            {
+                bool expected = false;
+                if (candidate.claimed.compare_exchange_strong(expected, true))
+                {
+                    participant = &candidate;
+                    break;
+                }
+            }
+            if (!participant)
+            {
+                std::printf("Epoch: more than %d reader threads\n", MAX_THREADS);
+                std::abort();
+            }
+        }
+        return *participant;
+    }
+
+    template <typename T>
+    void Retire(T* object)
+    {
+        if (!object)
+            return;
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        retired.push_back({ object, [](void* p) { delete static_cast<T*>(p); }, globalEpoch.load() });
+    }
+
+    // Frees what no reader can still see. Objects retired in epoch e are safe
+    // once every active reader entered after e.
+    inline void Collect()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest = globalEpoch.load();
+        for (const Participant& participant : participants)
+        {
+            uint64_t epoch = participant.epoch.load();
+            if (epoch != INACTIVE)
+                oldest = std::min(oldest, epoch);
+        }
+
+        std::vector<Retired> ready;
+        {
+            std::lock_guard<std::mutex> lock(retiredMutex);
+            auto keep = std::partition(retired.begin(), retired.end(), [oldest](const Retired& r) { return r.epoch >= oldest; });
+            ready.assign(keep, retired.end());
+            retired.erase(keep, retired.end());
+        }
+        for (const Retired& r : ready)
+            r.destroy(r.object);
+    }
+
+    inline void Advance()
+    {
+        globalEpoch.fetch_add(1);
+        Collect();
+    }
+
+    // At shutdown, once no reader is left
+    inline void FreeAll()
+    {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        for (const Retired& r : retired)
+            r.destroy(r.object);
+        retired.clear();
+    }
+
+    inline size_t GetPendingCount()
+    {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        return retired.size();
+    }
+}
+
+// Marks the calling thread as reading lock-free structures; nests
+class EpochScope
+{
+public:
+    EpochScope()
+    {
+        if (Depth()++ == 0)
+        {
+            Epoch::GetParticipant().epoch.store(Epoch::globalEpoch.load());
+            // The epoch must be visible before any pointer this scope loads
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    ~EpochScope()
+    {
+        if (--Depth() == 0)
+            Epoch::GetParticipant().epoch.store(Epoch::INACTIVE);
+    }
+
+    EpochScope(const EpochScope&) = delete;
+    EpochScope& operator=(const EpochScope&) = delete;
+
+private:
+    static int& Depth()
+    {
+        thread_local int depth = 0;
+        return depth;
+    }
+};
+
+// Index plus generation. A released slot bumps its generation, so old
+// handles to it resolve to nullptr instead of to whatever reuses the slot.
+template <typename T>
+struct Handle
+{
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 is never issued: a default handle is invalid
+
+    bool IsValid() const { return generation != 0; }
+    bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+// Fixed-capacity table of owned objects. Resolve() is lock-free and safe
+// from any thread inside an EpochScope; Publish/Replace/Release take a mutex
+// (loaders are rare writers) and hand superseded objects to Epoch::Retire.
+// Slots never move, so readers never see the table reallocate.
+template <typename T>
+class HandleTable
+{
+public:
+    explicit HandleTable(uint32_t capacity = 1024)
+        : m_Slots(new Slot[capacity]), m_Capacity(capacity)
+    {
+    }
+
+    ~HandleTable()
+    {
+        for (uint32_t i = 0; i < m_Used; ++i)
+            delete m_Slots[i].object.load();
+    }
+
+    HandleTable(const HandleTable&) = delete;
+    HandleTable& operator=(const HandleTable&) = delete;
+
+    // Takes ownership; returns an invalid handle (and keeps nothing) for a
+    // null object or when the table is full
+    Handle<T> Publish(T* object)
+    {
+        if (!object)
+            return Handle<T>();
+        std::lock_guard<std::mutex> lock(m_WriteMutex);
+        uint32_t index;
+        if (!m_FreeList.empty())
+        {
+            index = m_FreeList.back();
+            m_FreeList.pop_back();
+        }
+        else if (m_Used < m_Capacity)
+            index = m_Used++;
+        else
+        {
+            std::printf("HandleTable: full (%u entries)\n", m_Capacity);
+            delete object;
+            return Handle<T>();
+        }
+        Slot& slot = m_Slots[index];
+        slot.object.store(object, std::memory_order_release);
+        return { index, slot.generation.load(std::memory_order_relaxed) };
+    }
+
+    T* Resolve(Handle<T> handle) const
+    {
+        if (handle.index >= m_Capacity)
+            return nullptr;
+        const Slot& slot = m_Slots[handle.index];
+        if (slot.generation.load(std::memory_order_acquire) != handle.generation)
+            return nullptr;
+        T* object = slot.object.load(std::memory_order_acquire);
+        // The slot may have been released and reused between the two loads
+        if (slot.generation.load(std::memory_order_acquire) != handle.generation)
+            return nullptr;
+        return object;
+    }
+
+    // Hot reload: existing handles now resolve to the new object, the old one
+    // is freed once no frame can still be using it
+    bool Replace(Handle<T> handle, T* object)
+    {
+        std::lock_guard<std::mutex> lock(m_WriteMutex);
+        if (!IsLive(handle))
+        {
+            delete object;
+            return false;
+        }
+        Epoch::Retire(m_Slots[handle.index].object.exchange(object, std::memory_order_acq_rel));
+        return true;
+    }
+
+    void Release(Handle<T> handle)
+    {
+        std::lock_guard<std::mutex> lock(m_WriteMutex);
+        if (!IsLive(handle))
+            return;
+        Slot& slot = m_Slots[handle.index];
+        uint32_t next = slot.generation.load(std::memory_order_relaxed) + 1;
+        slot.generation.store(next == 0 ? 1 : next, std::memory_order_release);
+        Epoch::Retire(slot.object.exchange(nullptr, std::memory_order_acq_rel));
+        m_FreeList.push_back(handle.index);
+    }
+
+    uint32_t GetLiveCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_WriteMutex);
+        return m_Used - (uint32_t)m_FreeList.size();
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<T*> object{ nullptr };
+        std::atomic<uint32_t> generation{ 1 };
+    };
+
+    bool IsLive(Handle<T> handle) const
+    {
+        return handle.index < m_Used && m_Slots[handle.index].generation.load(std::memory_order_relaxed) == handle.generation;
+    }
+
+    std::unique_ptr<Slot[]> m_Slots;
+    uint32_t m_Capacity;
+    uint32_t m_Used = 0;
+    std::vector<uint32_t> m_FreeList;
+    mutable std::mutex m_WriteMutex;
+};
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Huge-page backing for the data a crowd update walks every frame: clip
+// keyframes, the palette slab and the pose arenas. With 4 KB pages those
+// arrays span thousands of pages and the dTLB misses on most of them; a 2 MB
+// page covers 512 times as much.
+//
+// Off unless --huge-pages is given. Each mapping then tries, in order:
+//  - explicit huge pages (MAP_HUGETLB), reserved from the pool set up with
+//    vm.nr_hugepages; fails right away when the pool is too small
+//  - transparent huge pages: a 2 MB aligned mapping marked MADV_HUGEPAGE,
+//    which the kernel backs with huge pages when it can
+//  - ordinary pages
+// so a system without either still runs, just without the benefit.
+// Report() shows which backing each kind of data got.
+namespace HugePages
+{
+    const size_t PAGE = 2 * 1024 * 1024;
+
+    enum class Backing
+    {
+        Normal,
+        Transparent,
+        Explicit,
+        Count
+    };
+
+    struct Mapping
+    {
+        unsigned char* data = nullptr;
+        size_t size = 0;
+        Backing backing = Backing::Normal;
+    };
+
+    inline bool enabled = false;
+    inline std::atomic<int64_t> mappedBytes[(int)Backing::Count] = {};
+
+    inline const char* GetName(Backing backing)
+    {
+        static const char* names[] = { "4 KB pages", "transparent huge pages", "explicit huge pages" };
+        return names[(int)backing];
+    }
+
+    // A whole number of PAGEs, 2 MB aligned; data is null when nothing could
+    // be mapped (or off Linux), and callers fall back to their usual storage
+    inline Mapping Map(size_t bytes)
+    {
+        Mapping mapping;
+#ifdef __linux__
+        size_t size = (bytes + PAGE - 1) & ~(PAGE - 1);
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED)
+            mapping = { (unsigned char*)data, size, Backing::Explicit };
+        else
+        {
+            // Over-map by a page and trim to a 2 MB boundary: THP only backs
+            // aligned 2 MB ranges
+            unsigned char* raw = (unsigned char*)mmap(nullptr, size + PAGE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == (unsigned char*)MAP_FAILED)
+                return mapping;
+            unsigned char* start = (unsigned char*)(((uintptr_t)raw + PAGE - 1) & ~(uintptr_t)(PAGE - 1));
+            if (start > raw)
+                munmap(raw, (size_t)(start - raw));
+            munmap(start + size, (size_t)(raw + size + PAGE - (start + size)));
+            bool advised = madvise(start, size, MADV_HUGEPAGE) == 0;
+            mapping = { start, size, advised ? Backing::Transparent : Backing::Normal };
+        }
+        mappedBytes[(int)mapping.backing] += (int64_t)mapping.size;
+#else
+        (void)bytes;
+#endif
+        return mapping;
+    }
+
+    inline void Unmap(Mapping& mapping)
+    {
+#ifdef __linux__
+        if (mapping.data)
+        {
+            munmap(mapping.data, mapping.size);
+            mappedBytes[(int)mapping.backing] -= (int64_t)mapping.size;
+        }
+#endif
+        mapping = Mapping();
+    }
+
+    // Small-object pool over PAGE-sized mappings, for containers (clip keys)
+    // that should live on huge pages: power-of-two size classes with free
+    // lists, so a vector growing during load hands its old blocks back for
+    // the next one. Larger requests get a mapping of their own. Only used at
+    // load time, so a mutex is enough.
+    const size_t MIN_BLOCK = 16;
+    const size_t MAX_BLOCK = 1024 * 1024;
+    const int CLASS_COUNT = 17; // 16 B .. 1 MB
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    inline std::mutex poolMutex;
+    inline std::atomic<bool> poolUsed{ false };
+    inline FreeBlock* freeLists[CLASS_COUNT] = {};
+    inline std::vector<Mapping> poolPages;
+    inline std::vector<Mapping> largeBlocks;
+    inline unsigned char* carveNext = nullptr;
+    inline unsigned char* carveEnd = nullptr;
+
+    inline int GetClass(size_t bytes)
+    {
+        int sizeClass = 0;
+        for (size_t block = MIN_BLOCK; block < bytes; block <<= 1)
+            sizeClass++;
+        return sizeClass;
+    }
+
+    inline void* Allocate(size_t bytes)
+    {
+        if (!enabled)
+            return ::operator new(bytes);
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (bytes > MAX_BLOCK)
+        {
+            Mapping mapping = Map(bytes);
+            if (!mapping.data)
+                return ::operator new(bytes);
+            MemoryStats::cpu[(int)MemTag::Clips].Add((int64_t)mapping.size);
+            largeBlocks.push_back(mapping);
+            poolUsed = true;
+            return mapping.data;
+        }
+
+        int sizeClass = GetClass(bytes);
+        if (FreeBlock* block = freeLists[sizeClass])
+        {
+            freeLists[sizeClass] = block->next;
+            return block;
+        }
+        size_t blockSize = MIN_BLOCK << sizeClass;
+        if ((size_t)(carveEnd - carveNext) < blockSize)
+        {
+            Mapping mapping = Map(PAGE);
+            if (!mapping.data)
+                return ::operator new(bytes);
+            MemoryStats::cpu[(int)MemTag::Clips].Add((int64_t)mapping.size);
+            poolPages.push_back(mapping);
+            poolUsed = true;
+            carveNext = mapping.data;
+            carveEnd = mapping.data + mapping.size;
+        }
+        void* block = carveNext;
+        carveNext += blockSize;
+        return block;
+    }
+
+    // bytes must be what was passed to Allocate. Blocks that came from the
+    // heap (pool off or out of mappings) are found by address.
+    inline void Free(void* pointer, size_t bytes)
+    {
+        if (!pointer)
+            return;
+        if (!poolUsed)
+        {
+            ::operator delete(pointer);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(poolMutex);
+        unsigned char* p = (unsigned char*)pointer;
+        for (size_t i = 0; i < largeBlocks.size(); ++i)
+        {
+            if (largeBlocks[i].data == p)
+            {
+                MemoryStats::cpu[(int)MemTag::Clips].Sub((int64_t)largeBlocks[i].size);
+                Unmap(largeBlocks[i]);
+                largeBlocks[i] = largeBlocks.back();
+                largeBlocks.pop_back();
+                return;
+            }
+        }
+        for (const Mapping& page : poolPages)
+        {
+            if (p >= page.data && p < page.data + page.size)
+            {
+                int sizeClass = GetClass(bytes);
+                FreeBlock* block = (FreeBlock*)pointer;
+                block->next = freeLists[sizeClass];
+                freeLists[sizeClass] = block;
+                return;
+            }
+        }
+        ::operator delete(pointer);
+    }
+
+    // Transparent huge pages actually in use by the process, from the
+    // kernel's view (the advice alone does not guarantee any); -1 if unknown
+    inline int64_t GetTransparentHugeBytes()
+    {
+        FILE* file = std::fopen("/proc/self/smaps_rollup", "r");
+        if (!file)
+            return -1;
+        char line[256];
+        long long kb = -1;
+        while (std::fgets(line, sizeof(line), file))
+            if (std::sscanf(line, "AnonHugePages: %lld kB", &kb) == 1)
+                break;
+        std::fclose(file);
+        return kb < 0 ? -1 : kb * 1024;
+    }
+
+    inline void Report()
+    {
+        if (!enabled)
+        {
+            std::printf("huge pages: off (--huge-pages to enable)\n");
+            return;
+        }
+        std::printf("huge pages: %.1f MB explicit, %.1f MB advised transparent (%.1f MB backed), %.1f MB fell back to 4 KB; "
+            "clip key pool %zu pages + %zu large blocks\n",
+            mappedBytes[(int)Backing::Explicit] / (1024.0 * 1024.0), mappedBytes[(int)Backing::Transparent] / (1024.0 * 1024.0),
+            std::max<int64_t>(GetTransparentHugeBytes(), 0) / (1024.0 * 1024.0), mappedBytes[(int)Backing::Normal] / (1024.0 * 1024.0),
+            poolPages.size(), largeBlocks.size());
+    }
+}
+
+// Allocator for containers that should sit on huge pages when they are
+// enabled, and behave like std::allocator otherwise
+template <typename T>
+struct HugePageAllocator
+{
+    using value_type = T;
+
+    HugePageAllocator() = default;
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t count) { return (T*)HugePages::Allocate(count * sizeof(T)); }
+    void deallocate(T* pointer, size_t count) { HugePages::Free(pointer, count * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>&) const { return true; }
+};
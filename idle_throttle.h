@@ -0,0 +1,89 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+// Drops the loop to a low update/render rate while nothing is happening: no
+// input, a still camera and only the looping idle clip playing. The wait is
+// glfwWaitEventsTimeout, so any input wakes the loop immediately instead of
+// at the next throttled frame.
+//
+// Process CPU time is accumulated separately for active and quiet frames
+// (quiet = would be throttled), with throttling on or off, so running once
+// with each setting shows the saving in Report().
+class IdleThrottle
+{
+public:
+    double idleHz = 10.0;     // update/render rate while idle
+    double idleDelay = 0.5;   // seconds without activity before throttling
+    bool enabled = true;
+
+    // Input callbacks call this; anything that changes the picture may too
+    void NoteActivity(double now) { m_LastActivity = now; }
+
+    // Once per frame with whether the scene is otherwise static; returns true
+    // when the coming frame is a throttled one
+    bool Update(double now, bool sceneStatic)
+    {
+        std::clock_t cpu = std::clock();
+        if (m_LastUpdate > 0.0)
+        {
+            Bucket& bucket = m_Quiet ? m_QuietStats : m_ActiveStats;
+            bucket.wallSeconds += now - m_LastUpdate;
+            bucket.cpuSeconds += (double)(cpu - m_LastCpu) / CLOCKS_PER_SEC;
+            bucket.frames++;
+        }
+        m_LastUpdate = now;
+        m_LastCpu = cpu;
+
+        if (!sceneStatic)
+            m_LastActivity = now;
+        m_Quiet = now - m_LastActivity >= idleDelay;
+        m_Idle = enabled && m_Quiet;
+        return m_Idle;
+    }
+
+    // Blocks until the next throttled frame is due or an event arrives
+    void Wait()
+    {
+        if (!m_Idle)
+            return;
+        double remaining = m_LastUpdate + 1.0 / idleHz - glfwGetTime();
+        if (remaining > 0.0)
+            glfwWaitEventsTimeout(remaining);
+    }
+
+    bool IsIdle() const { return m_Idle; }
+
+    void Report() const
+    {
+        auto print = [](const char* name, const Bucket& bucket) {
+            double utilization = bucket.wallSeconds > 0.0 ? bucket.cpuSeconds / bucket.wallSeconds * 100.0 : 0.0;
+            double fps = bucket.wallSeconds > 0.0 ? bucket.frames / bucket.wallSeconds : 0.0;
+            std::printf("%-7s %8.1f s %8.1f fps %7.1f%% CPU\n", name, bucket.wallSeconds, fps, utilization);
+        };
+        std::printf("idle throttling %s (CPU is %% of one core, all threads)\n", enabled ? "on" : "off");
+        print("active", m_ActiveStats);
+        print("quiet", m_QuietStats);
+    }
+
+private:
+    struct Bucket
+    {
+        double wallSeconds = 0.0;
+        double cpuSeconds = 0.0;
+        long long frames = 0;
+    };
+
+    double m_LastActivity = 0.0;
+    double m_LastUpdate = 0.0;
+    std::clock_t m_LastCpu = 0;
+    bool m_Quiet = false;
+    bool m_Idle = false;
+
+    Bucket m_ActiveStats;
+    Bucket m_QuietStats;
+};
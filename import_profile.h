@@ -0,0 +1,66 @@
+#pragma once
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+
+#include "async_io.h"
+
+#include <string>
+
+// What an Assimp import is for. Each profile only asks for the post-process
+// steps its consumer needs and strips the rest of the scene before they run.
+enum class ImportProfile
+{
+    SkinOnly,   // skinned meshes + diffuse textures, what anim_model.vs draws
+    AnimOnly,   // node hierarchy + keyframes; meshes and materials are dropped
+    Full        // everything LearnOpenGL's Model asks for, incl. tangent space
+};
+
+inline const char* GetProfileName(ImportProfile profile)
+{
+    switch (profile)
+    {
+    case ImportProfile::SkinOnly: return "assimp:skin";
+    case ImportProfile::AnimOnly: return "assimp:anim";
+    default: return "assimp:full";
+    }
+}
+
+inline unsigned int ConfigureImporter(Assimp::Importer& importer, ImportProfile profile)
+{
+    switch (profile)
+    {
+    case ImportProfile::AnimOnly:
+        // Nothing to triangulate or shade: drop geometry before any step sees it
+        importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,
+            aiComponent_MESHES | aiComponent_MATERIALS | aiComponent_TEXTURES |
+            aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_COLORS);
+        return aiProcess_RemoveComponent;
+
+    case ImportProfile::SkinOnly:
+        // The skinning shader reads position, normal, uv0 and 4 bone weights
+        importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,
+            aiComponent_TANGENTS_AND_BITANGENTS | aiComponent_COLORS |
+            aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_ANIMATIONS);
+        importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, 4);
+        return aiProcess_RemoveComponent | aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+            aiProcess_LimitBoneWeights;
+
+    default:
+        return aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace;
+    }
+}
+
+// Parses from the preloaded bytes when the file is in the current load set
+// (see AsyncIO::Preload), otherwise lets Assimp open it. The extension is the
+// format hint Assimp needs for in-memory reads.
+inline const aiScene* ReadScene(Assimp::Importer& importer, const std::string& path, unsigned int flags)
+{
+    if (const AsyncIO::FileData* file = AsyncIO::FindPreloaded(path))
+    {
+        size_t dot = path.find_last_of('.');
+        std::string hint = dot == std::string::npos ? "" : path.substr(dot + 1);
+        return importer.ReadFileFromMemory(file->data, file->size, flags, hint.c_str());
+    }
+    return importer.ReadFile(path, flags);
+}
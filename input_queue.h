@@ -0,0 +1,160 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+struct KeyEvent
+{
+    int key;
+    int action;     // GLFW_PRESS or GLFW_RELEASE
+    double time;    // glfwGetTime() in the callback, i.e. when glfwPollEvents delivered it
+};
+
+// Single-producer/single-consumer ring. The key callback pushes, processInput
+// pops; neither side ever blocks or allocates.
+template <size_t Capacity>
+class KeyEventRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool Push(const KeyEvent& e)
+    {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head - m_Tail.load(std::memory_order_acquire) == Capacity)
+            return false; // full: drop rather than block the callback
+        m_Events[head & (Capacity - 1)] = e;
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(KeyEvent& e)
+    {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail == m_Head.load(std::memory_order_acquire))
+            return false;
+        e = m_Events[tail & (Capacity - 1)];
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    KeyEvent m_Events[Capacity];
+    alignas(64) std::atomic<size_t> m_Head{ 0 };
+    alignas(64) std::atomic<size_t> m_Tail{ 0 };
+};
+
+enum InputAction
+{
+    ACTION_NONE = -1,
+    ACTION_QUIT,
+    ACTION_WALK,
+    ACTION_TURN_LEFT,
+    ACTION_TURN_RIGHT,
+    ACTION_JUMP,
+    ACTION_DANCE,
+    ACTION_DEBUG_OVERLAY,
+    ACTION_MEMORY_REPORT,
+    ACTION_SCHEDULER_REPORT,
+    ACTION_RENDER_REPORT,
+    ACTION_DYNAMIC_RESOLUTION,
+    ACTION_PRESENT_MODE,
+    ACTION_PROFILE_REPORT,
+    ACTION_COUNT
+};
+
+struct ActionEvent
+{
+    InputAction action;
+    bool pressed;   // false for release
+    double time;
+};
+
+// Turns queued key events into action edges. Only keys that change state cost
+// anything, and presses shorter than a frame still produce both edges, in order.
+class InputMapper
+{
+public:
+    InputMapper()
+    {
+        std::fill(m_Bindings, m_Bindings + GLFW_KEY_LAST + 1, ACTION_NONE);
+        for (int i = 0; i < ACTION_COUNT; ++i)
+        {
+            m_HeldSince[i] = -1.0;
+            m_HeldSeconds[i] = 0.0;
+        }
+    }
+
+    void Bind(int key, InputAction action)
+    {
+        if (key >= 0 && key <= GLFW_KEY_LAST)
+            m_Bindings[key] = action;
+    }
+
+    // Called from the GLFW key callback
+    void OnKey(int key, int action, double time)
+    {
+        if (action == GLFW_REPEAT || key < 0 || key > GLFW_KEY_LAST || m_Bindings[key] == ACTION_NONE)
+            return;
+        m_Queue.Push({ key, action, time });
+    }
+
+    // Start of the window [frameStart, frameEnd] that GetHeldSeconds() reports on
+    void BeginFrame(double frameStart, double frameEnd)
+    {
+        m_FrameStart = frameStart;
+        m_FrameEnd = frameEnd;
+        for (int i = 0; i < ACTION_COUNT; ++i)
+            m_HeldSeconds[i] = 0.0;
+    }
+
+    // Next action edge in arrival order; false once the queue is drained
+    bool Poll(ActionEvent& out)
+    {
+        KeyEvent e;
+        while (m_Queue.Pop(e))
+        {
+            InputAction action = m_Bindings[e.key];
+            bool pressed = e.action == GLFW_PRESS;
+            bool wasHeld = m_HeldSince[action] >= 0.0;
+            if (pressed == wasHeld)
+                continue; // not an edge
+
+            double time = std::max(e.time, m_FrameStart);
+            if (pressed)
+                m_HeldSince[action] = time;
+            else
+            {
+                m_HeldSeconds[action] += time - std::max(m_HeldSince[action], m_FrameStart);
+                m_HeldSince[action] = -1.0;
+            }
+            out = { action, pressed, time };
+            return true;
+        }
+        return false;
+    }
+
+    bool IsHeld(InputAction action) const { return m_HeldSince[action] >= 0.0; }
+
+    // How long the action was held during the current frame window. Call after
+    // the queue is drained. Event times are poll times, so this is at poll
+    // resolution: a press and release delivered by the same poll count as 0.
+    float GetHeldSeconds(InputAction action) const
+    {
+        double held = m_HeldSeconds[action];
+        if (m_HeldSince[action] >= 0.0)
+            held += m_FrameEnd - std::max(m_HeldSince[action], m_FrameStart);
+        return (float)held;
+    }
+
+private:
+    KeyEventRing<256> m_Queue;
+    InputAction m_Bindings[GLFW_KEY_LAST + 1];
+    double m_HeldSince[ACTION_COUNT];
+    double m_HeldSeconds[ACTION_COUNT];
+    double m_FrameStart = 0.0;
+    double m_FrameEnd = 0.0;
+};
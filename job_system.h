@@ -0,0 +1,179 @@
+#pragma once
+
+#include "cpu_topology.h"
+#include "pose_arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads running one ParallelFor at a time. The calling
+// thread works on the batch too, so a pool with zero workers degrades to a
+// plain loop. Items are handed out dynamically, so anything that combines
+// results across items must go through ParallelReduce (or write per item) to
+// stay independent of the thread count.
+//
+// Worker k runs in topology slot k+1 (see cpu_topology.h), pinned when
+// pinWorkers is set, at a lower priority than the render thread, and owns a
+// pose arena allocated from its own node.
+class JobSystem
+{
+public:
+    explicit JobSystem(unsigned workerCount = GetDefaultWorkerCount(), bool pinWorkers = CpuTopology::pinThreads)
+        : m_PinWorkers(pinWorkers)
+    {
+        for (unsigned i = 0; i < workerCount; ++i)
+            m_Workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Quit = true;
+        }
+        m_Wake.notify_all();
+        for (std::thread& worker : m_Workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Calls fn(i) for every i in [0, count) and returns once all calls finished
+    void ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+    {
+        if (count == 0)
+            return;
+        if (m_Workers.empty() || count == 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                fn(i);
+            return;
+        }
+
+        std::lock_guard<std::mutex> submit(m_SubmitMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Job = &fn;
+            m_Count = count;
+            m_Next.store(0, std::memory_order_relaxed);
+            m_Done.store(0, std::memory_order_relaxed);
+            m_Generation++;
+        }
+        m_Wake.notify_all();
+
+        RunItems(fn);
+
+        // Also wait for workers that picked the batch up but found no items left,
+        // so none of them can touch `fn` after it goes out of scope
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Finished.wait(lock, [this] { return m_Done.load(std::memory_order_acquire) == m_Count && m_Active == 0; });
+        m_Job = nullptr;
+    }
+
+    // Fixed partitioning: [0, count) is cut into chunks of chunkSize whatever
+    // the number of threads, so the ranges fn sees are the same on 1 or N
+    // threads (only which thread runs a chunk varies)
+    void ParallelForChunks(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& fn)
+    {
+        size_t chunks = (count + chunkSize - 1) / chunkSize;
+        ParallelFor(chunks, [&](size_t c) { fn(c * chunkSize, std::min(count, (c + 1) * chunkSize)); });
+    }
+
+    // Ordered reduction over fixed chunks: reduceChunk(begin, end) produces one
+    // partial per chunk, and the partials are combined left to right on the
+    // calling thread. Floating-point results are therefore bitwise identical
+    // for any worker count, unlike accumulating into a shared total.
+    template <typename T, typename ReduceFn, typename CombineFn>
+    T ParallelReduce(size_t count, size_t chunkSize, T identity, const ReduceFn& reduceChunk, const CombineFn& combine)
+    {
+        size_t chunks = (count + chunkSize - 1) / chunkSize;
+        std::vector<T> partials(chunks, identity);
+        ParallelFor(chunks, [&](size_t c) { partials[c] = reduceChunk(c * chunkSize, std::min(count, (c + 1) * chunkSize)); });
+        T result = identity;
+        for (const T& partial : partials)
+            result = combine(result, partial);
+        return result;
+    }
+
+    unsigned GetWorkerCount() const { return (unsigned)m_Workers.size(); }
+
+    static unsigned GetDefaultWorkerCount()
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+private:
+    void WorkerLoop(unsigned index)
+    {
+        CpuTopology::PlaceCurrentThread(index + 1, m_PinWorkers);
+        CpuTopology::LowerCurrentThreadPriority(CpuTopology::workerNice);
+        PoseArena::ForThisThread(); // first touch after pinning
+
+        size_t seen = 0;
+        for (;;)
+        {
+            const std::function<void(size_t)>* job;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Wake.wait(lock, [&] { return m_Quit || (m_Generation != seen && m_Job); });
+                if (m_Quit)
+                    return;
+                seen = m_Generation;
+                job = m_Job;
+                m_Active++;
+            }
+            RunItems(*job);
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (--m_Active == 0)
+                    m_Finished.notify_all();
+            }
+        }
+    }
+
+    void RunItems(const std::function<void(size_t)>& fn)
+    {
+        size_t finished = 0;
+        for (size_t i = m_Next.fetch_add(1, std::memory_order_relaxed); i < m_Count;
+             i = m_Next.fetch_add(1, std::memory_order_relaxed))
+        {
+            fn(i);
+            finished++;
+        }
+        if (finished && m_Done.fetch_add(finished, std::memory_order_acq_rel) + finished == m_Count)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Finished.notify_all();
+        }
+    }
+
+    bool m_PinWorkers;
+    std::vector<std::thread> m_Workers;
+    std::mutex m_SubmitMutex;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::condition_variable m_Finished;
+    bool m_Quit = false;
+    unsigned m_Active = 0;
+
+    const std::function<void(size_t)>* m_Job = nullptr;
+    size_t m_Count = 0;
+    size_t m_Generation = 0;
+    std::atomic<size_t> m_Next{ 0 };
+    std::atomic<size_t> m_Done{ 0 };
+};
+
+// Shared pool used by loaders and animation; created on first use
+inline JobSystem& GetJobSystem()
+{
+    static JobSystem jobs;
+    return jobs;
+}
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Small DOM-style JSON reader/writer, enough for glTF headers and the
+// benchmark/baseline files. Missing keys and out-of-range indices return a
+// shared null value so lookups can be chained without checks.
+class JsonValue
+{
+public:
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    static JsonValue Parse(const char* text, size_t length, bool* ok = nullptr)
+    {
+        Parser parser{ text, text + length, true };
+        JsonValue value;
+        parser.SkipSpace();
+        parser.ParseValue(value);
+        parser.SkipSpace();
+        if (ok)
+            *ok = parser.ok && parser.p == parser.end;
+        return value;
+    }
+
+    static JsonValue MakeNumber(double n) { JsonValue v; v.type = Number; v.number = n; return v; }
+    static JsonValue MakeString(const std::string& s) { JsonValue v; v.type = String; v.string = s; return v; }
+    static JsonValue MakeObject() { JsonValue v; v.type = Object; return v; }
+    static JsonValue MakeArray() { JsonValue v; v.type = Array; return v; }
+
+    bool IsNull() const { return type == Null; }
+    bool Has(const char* key) const { return !(*this)[key].IsNull(); }
+    size_t Size() const { return type == Array ? array.size() : type == Object ? object.size() : 0; }
+
+    const JsonValue& operator[](const char* key) const
+    {
+        if (type == Object)
+            for (const auto& member : object)
+                if (member.first == key)
+                    return member.second;
+        return GetNull();
+    }
+
+    const JsonValue& operator[](size_t index) const
+    {
+        return (type == Array && index < array.size()) ? array[index] : GetNull();
+    }
+
+    // Inserts or replaces a member
+    JsonValue& Set(const std::string& key, const JsonValue& value)
+    {
+        type = Object;
+        for (auto& member : object)
+            if (member.first == key)
+                return member.second = value;
+        object.emplace_back(key, value);
+        return object.back().second;
+    }
+
+    // The fallback also covers numbers outside int's range, whose cast is undefined
+    int AsInt(int fallback = 0) const
+    {
+        return type == Number && number >= (double)INT_MIN && number <= (double)INT_MAX ? (int)number : fallback;
+    }
+    float AsFloat(float fallback = 0.0f) const { return type == Number ? (float)number : fallback; }
+    double AsDouble(double fallback = 0.0) const { return type == Number ? number : fallback; }
+    const std::string& AsString() const { return type == String ? string : GetNull().string; }
+
+    std::string Dump(int indent = 0) const
+    {
+        std::string out;
+        Write(out, indent, 0);
+        return out;
+    }
+
+private:
+    static const JsonValue& GetNull()
+    {
+        static const JsonValue null;
+        return null;
+    }
+
+    void Write(std::string& out, int indent, int depth) const
+    {
+        auto newline = [&](int d) {
+            if (indent > 0)
+            {
+                out += '\n';
+                out.append((size_t)(indent * d), ' ');
+            }
+        };
+        switch (type)
+        {
+        case Null: out += "null"; break;
+        case Bool: out += boolean ? "true" : "false"; break;
+        case Number:
+        {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", number);
+            out += buffer;
+            break;
+        }
+        case String: WriteString(out, string); break;
+        case Array:
+            out += '[';
+            for (size_t i = 0; i < array.size(); ++i)
+            {
+                if (i)
+                    out += ',';
+                newline(depth + 1);
+                array[i].Write(out, indent, depth + 1);
+            }
+            if (!array.empty())
+                newline(depth);
+            out += ']';
+            break;
+        case Object:
+            out += '{';
+            for (size_t i = 0; i < object.size(); ++i)
+            {
+                if (i)
+                    out += ',';
+                newline(depth + 1);
+                WriteString(out, object[i].first);
+                out += indent > 0 ? ": " : ":";
+                object[i].second.Write(out, indent, depth + 1);
+            }
+            if (!object.empty())
+                newline(depth);
+            out += '}';
+            break;
+        }
+    }
+
+    static void WriteString(std::string& out, const std::string& s)
+    {
+        out += '"';
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (c == '\n')
+                out += "\\n";
+            else
+                out += c;
+        }
+        out += '"';
+    }
+
+    // Deeper nesting than any glTF or baseline file has; a hostile file
+    // nested further would otherwise overflow the stack
+    static const int MAX_DEPTH = 256;
+
+    struct Parser
+    {
+        const char* p;
+        const char* end;
+        bool ok;
+
+        void SkipSpace()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                ++p;
+        }
+
+        bool Consume(char c)
+        {
+            SkipSpace();
+            if (p < end && *p == c)
+            {
+                ++p;
+                return true;
+            }
+            return false;
+        }
+
+        bool Literal(const char* word)
+        {
+            size_t n = std::strlen(word);
+            if ((size_t)(end - p) < n || std::strncmp(p, word, n) != 0)
+                return false;
+            p += n;
+            return true;
+        }
+
+        void ParseValue(JsonValue& v, int depth = 0)
+        {
+            SkipSpace();
+            if (!ok || p >= end || depth >= MAX_DEPTH)
+            {
+                ok = false;
+                return;
+            }
+            switch (*p)
+            {
+            case '{':
+                ++p;
+                v.type = Object;
+                if (Consume('}'))
+                    return;
+                do
+                {
+                    SkipSpace();
+                    std::string key;
+                    if (!ParseString(key) || !Consume(':'))
+                    {
+                        ok = false;
+                        return;
+                    }
+                    v.object.emplace_back(std::move(key), JsonValue());
+                    ParseValue(v.object.back().second, depth + 1);
+                } while (ok && Consume(','));
+                if (!Consume('}'))
+                    ok = false;
+                return;
+            case '[':
+                ++p;
+                v.type = Array;
+                if (Consume(']'))
+                    return;
+                do
+                {
+                    v.array.emplace_back();
+                    ParseValue(v.array.back(), depth + 1);
+                } while (ok && Consume(','));
+                if (!Consume(']'))
+                    ok = false;
+                return;
+            case '"':
+                v.type = String;
+                ok = ParseString(v.string);
+                return;
+            case 't':
+                v.type = Bool;
+                v.boolean = true;
+                ok = Literal("true");
+                return;
+            case 'f':
+                v.type = Bool;
+                ok = Literal("false");
+                return;
+            case 'n':
+                ok = Literal("null");
+                return;
+            default:
+            {
+                // The text need not be NUL-terminated (a GLB's JSON chunk), so
+                // the number is matched against the JSON grammar within
+                // [p, end) first and only that copy is converted. strtod alone
+                // would read on past end and accept inf, nan and hex.
+                const char* start = p;
+                v.type = Number;
+                ok = ParseNumber();
+                if (!ok)
+                    return;
+                v.number = std::strtod(std::string(start, p).c_str(), nullptr);
+                if (!std::isfinite(v.number))
+                    ok = false;
+                return;
+            }
+            }
+        }
+
+        bool ParseDigits()
+        {
+            const char* start = p;
+            while (p < end && *p >= '0' && *p <= '9')
+                ++p;
+            return p > start;
+        }
+
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        bool ParseNumber()
+        {
+            if (p < end && *p == '-')
+                ++p;
+            if (p < end && *p == '0')
+                ++p;
+            else if (!ParseDigits())
+                return false;
+            if (p < end && *p == '.')
+            {
+                ++p;
+                if (!ParseDigits())
+                    return false;
+            }
+            if (p < end && (*p == 'e' || *p == 'E'))
+            {
+                ++p;
+                if (p < end && (*p == '+' || *p == '-'))
+                    ++p;
+                if (!ParseDigits())
+                    return false;
+            }
+            return true;
+        }
+
+        bool ParseString(std::string& out)
+        {
+            if (p >= end || *p != '"')
+                return false;
+            ++p;
+            while (p < end && *p != '"')
+            {
+                char c = *p++;
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (p >= end)
+                    return false;
+                char e = *p++;
+                switch (e)
+                {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u':
+                {
+                    // Names in our assets are ASCII; keep BMP code points as UTF-8
+                    if (end - p < 4)
+                        return false;
+                    unsigned code = (unsigned)std::strtoul(std::string(p, 4).c_str(), nullptr, 16);
+                    p += 4;
+                    if (code < 0x80)
+                        out += (char)code;
+                    else if (code < 0x800)
+                    {
+                        out += (char)(0xC0 | (code >> 6));
+                        out += (char)(0x80 | (code & 0x3F));
+                    }
+                    else
+                    {
+                        out += (char)(0xE0 | (code >> 12));
+                        out += (char)(0x80 | ((code >> 6) & 0x3F));
+                        out += (char)(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: out += e; break;
+                }
+            }
+            if (p >= end)
+                return false;
+            ++p;
+            return true;
+        }
+    };
+};
@@ -8,20 +8,57 @@
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
-#include <learnopengl/animator.h>
 #include <learnopengl/model_animation.h>
 
+#define MEMORY_STATS_IMPLEMENTATION
+#include "memory_stats.h"
+
+#include "anim_scheduler.h"
+#include "asset_handles.h"
+#include "asset_loader.h"
+#include "behaviour.h"
+#include "bench.h"
+#include "character_animator.h"
+#include "clip_mirror.h"
+#include "cpu_topology.h"
+#include "debug_draw.h"
+#include "dynamic_resolution.h"
+#include "frame_pacer.h"
+#include "frame_profiler.h"
+#include "huge_pages.h"
+#include "idle_throttle.h"
+#include "input_queue.h"
+#include "render_stats.h"
+
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <span>
 
 // Callback declarations
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
 
 // Window
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 700;
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+
+// Scene resolution follows the GPU time budget; F5 toggles it
+DynamicResolution* dynamicResolution;
+
+// Presentation mode (--present=vsync|uncapped|capped|low-latency); F6 cycles it
+FramePacer* framePacer;
+PresentMode presentMode = PresentMode::VSync;
+
+// Drops to a low frame rate while only the idle loop plays (--no-idle disables)
+IdleThrottle idleThrottle;
+glm::mat4 lastView = glm::mat4(0.0f);
+float lastZoom = 0.0f;
 
 // Camera
 Camera camera(glm::vec3(0.0f, 2.0f, 6.0f));
@@ -34,19 +71,50 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 // Animation & Model
-Animator* animator;
-Animation* idleAnim;
-Animation* walkAnim;
-Animation* leftTurnAnim;
-Animation* rightTurnAnim;
-Animation* jumpAnim;
-Animation* danceAnim;
-Model* ourModel;
+Skeleton* skeleton;
+CharacterAnimator* animator;
+// Owned by AssetHandles; resolved each frame
+ClipHandle idleAnim;
+ClipHandle walkAnim;
+ClipHandle leftTurnAnim;
+ClipHandle rightTurnAnim;
+ClipHandle jumpAnim;
+ClipHandle danceAnim;
+ModelHandle ourModel;
+
+// Only Left Turn.dae is loaded: the right turn is its mirror, baked into its
+// own clip at load, or mirrored while sampling with --mirror=sample (then
+// rightTurnAnim stays invalid). --mirror=off loads Right Turn.dae instead.
+enum class TurnMirror
+{
+    Off,
+    Bake,
+    Sample
+};
+TurnMirror turnMirror = TurnMirror::Bake;
+ClipMirror* clipMirror;
+
+// Props attached to skeleton sockets, drawn together with the character
+struct Attachment
+{
+    ModelHandle model;
+    int socket;
+};
+std::vector<Attachment> attachments;
+
+// Bone/bounds overlay, toggled with F1
+DebugDraw* debugDraw;
+
+// Pose evaluation is capped to a per-frame budget; F3 prints its stats
+AnimationScheduler animScheduler;
 
 // Transform control
 glm::vec3 modelPosition = glm::vec3(0.0f, -0.5f, 0.0f);
 float modelRotation = 0.0f;
+const float modelScale = 0.5f;
 float moveSpeed = 2.0f;
+// Walk clip playback rate that makes its feet cover moveSpeed (see measureStrideSpeed)
+float walkRate = 1.0f;
 
 // Animation state system
 enum AnimationState {
@@ -59,30 +127,116 @@ enum AnimationState {
 };
 
 AnimationState currentState = IDLE;
-Animation* currentAnim = nullptr;
+ClipHandle currentAnim;
 
 // Turn animation control
-float turnStartRotation = 0.0f;
-float turnTargetRotation = 0.0f;
-float turnProgress = 0.0f;
 float turnDuration = 0.5f;
 
-// Key press detection (prevent holding)
-bool wasAPressed = false;
-bool wasDPressed = false;
-bool wasSpacePressed = false;
-bool was1Pressed = false;
+// Timed sequences (turns, jumps) run as coroutines, resumed once per frame
+// from processInput; F3 reports their resume cost
+BehaviourScheduler behaviours;
+
+// Key events queued by key_callback and turned into action edges
+InputMapper inputMapper;
 
-// Helper: switch animation safely
-void switchAnimation(Animation* newAnim)
+// Helper: switch animation safely. A mirror plays the clip mirrored in the
+// sampling loop.
+void switchAnimation(ClipHandle newAnim, const ClipMirror* mirror = nullptr)
 {
-    if (animator && newAnim && newAnim != currentAnim)
+    if (animator && newAnim.IsValid() && (newAnim != currentAnim || mirror != animator->GetMirror()))
     {
-        animator->PlayAnimation(newAnim);
+        animator->PlayAnimation(newAnim, mirror);
+        animator->SetRate(newAnim == walkAnim ? walkRate : 1.0f);
         currentAnim = newAnim;
     }
 }
 
+// Eases the model to the target heading over turnDuration, then idles
+Behaviour turnBehaviour(float startTime, float targetRotation)
+{
+    float startRotation = modelRotation;
+    for (;;)
+    {
+        float t = ((float)behaviours.GetTime() - startTime) / turnDuration;
+        if (t >= 1.0f)
+            break;
+        t = glm::clamp(t, 0.0f, 1.0f);
+        t = t * t * (3.0f - 2.0f * t); // smoothstep
+        modelRotation = startRotation + (targetRotation - startRotation) * t;
+        co_await NextFrame();
+    }
+    modelRotation = targetRotation;
+    currentState = IDLE;
+    switchAnimation(idleAnim);
+}
+
+// Back to idle once the jump has played through, unless input took over
+Behaviour jumpBehaviour()
+{
+    co_await ClipFinished(animator, jumpAnim);
+    if (currentState == JUMPING)
+    {
+        currentState = IDLE;
+        switchAnimation(idleAnim);
+    }
+}
+
+// Report the GPU side of a loaded model: mesh buffers and its textures
+void trackModelMemory(SkinnedModel* model)
+{
+    MemoryStats::TrackGpu(MemTag::Meshes, (int64_t)(model->GetVertexBytes() + model->GetIndexBytes()));
+
+    int64_t textureBytes = 0;
+    for (const Texture& texture : model->textures_loaded)
+    {
+        GLint width = 0, height = 0, format = 0;
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        int bytesPerTexel = (format == GL_RED) ? 1 : 4; // drivers pad RGB to 4 bytes
+        textureBytes += (int64_t)width * height * bytesPerTexel * 4 / 3; // + mip chain
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    MemoryStats::TrackGpu(MemTag::Textures, textureBytes);
+}
+
+// Ground speed a locomotion clip shows at rate 1, in world units per second:
+// how fast the planted (lower) foot moves against the hips, horizontally.
+// Works whether the clip moves its root or walks in place. 0 when the rig has
+// no such feet or the clip does not move them.
+float measureStrideSpeed(ClipHandle clip)
+{
+    AnimClip* resolved = AssetHandles::clips.Resolve(clip);
+    int hips = skeleton->FindNode("mixamorig:Hips");
+    int feet[2] = { skeleton->FindNode("mixamorig:LeftFoot"), skeleton->FindNode("mixamorig:RightFoot") };
+    if (!resolved || resolved->GetTicksPerSecond() <= 0.0f || hips < 0 || feet[0] < 0 || feet[1] < 0)
+        return 0.0f;
+
+    const int steps = 120;
+    float seconds = resolved->GetDuration() / resolved->GetTicksPerSecond() / steps;
+    CharacterAnimator probe(skeleton, resolved);
+    glm::vec3 previous[2];
+    float distance = 0.0f;
+    for (int step = 0; step <= steps; ++step)
+    {
+        probe.UpdateAnimation(step == 0 ? 0.0f : seconds);
+        const std::vector<glm::mat4>& global = probe.GetGlobalTransforms();
+        glm::vec3 relative[2];
+        for (int f = 0; f < 2; ++f)
+            relative[f] = glm::vec3(global[feet[f]][3] - global[hips][3]);
+        if (step > 0)
+        {
+            int planted = global[feet[0]][3].y < global[feet[1]][3].y ? 0 : 1;
+            glm::vec3 moved = relative[planted] - previous[planted];
+            distance += glm::length(glm::vec2(moved.x, moved.z));
+        }
+        previous[0] = relative[0];
+        previous[1] = relative[1];
+    }
+    return distance / (seconds * steps) * modelScale;
+}
+
 // Move forward in facing direction
 void moveForward(float speed)
 {
@@ -90,8 +244,59 @@ void moveForward(float speed)
     modelPosition.z += cos(modelRotation) * speed;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    // --assimp forces the Assimp fallback and --no-bake skips baked models,
+    // so load times and startup RSS can be compared; --bake-codec=none|lz4|zstd
+    // rebakes with that blob compression to compare startup per codec.
+    // --mirror=off|sample picks how the right turn is made (see TurnMirror).
+    // --huge-pages puts clip keys, palettes and pose scratch on huge pages
+    // (huge_pages.h); it has to come before anything is loaded. --bench
+    // runs the headless regression benchmark (bench.h) instead of the viewer.
+    bool runBench = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--bench") == 0)
+            runBench = true;
+        else if (std::strcmp(argv[i], "--assimp") == 0)
+            AssetLoader::preferGlb = false;
+        else if (std::strcmp(argv[i], "--no-bake") == 0)
+            AssetLoader::useBaked = false;
+        else if (std::strcmp(argv[i], "--perf") == 0)
+            FrameProfiler::EnableCounters();
+        else if (std::strcmp(argv[i], "--no-idle") == 0)
+            idleThrottle.enabled = false;
+        else if (std::strcmp(argv[i], "--no-pin") == 0)
+            CpuTopology::pinThreads = false;
+        else if (std::strcmp(argv[i], "--no-uring") == 0)
+            AsyncIO::useUring = false;
+        else if (std::strcmp(argv[i], "--cold") == 0)
+            AsyncIO::dropCaches = true;
+        else if (std::strcmp(argv[i], "--huge-pages") == 0)
+            HugePages::enabled = true;
+        else if (std::strncmp(argv[i], "--bake-codec=", 13) == 0)
+        {
+            BlobCodec::Codec codec;
+            if (!BlobCodec::Parse(argv[i] + 13, codec) || !BlobCodec::IsAvailable(codec))
+                std::cout << "Codec " << argv[i] + 13 << " not available, baking with "
+                          << BlobCodec::GetName(BakedModel::codec) << std::endl;
+            else
+                BakedModel::codec = codec;
+        }
+        else if (std::strcmp(argv[i], "--mirror=off") == 0)
+            turnMirror = TurnMirror::Off;
+        else if (std::strcmp(argv[i], "--mirror=sample") == 0)
+            turnMirror = TurnMirror::Sample;
+        else if (std::strncmp(argv[i], "--present=", 10) == 0 && !ParsePresentMode(argv[i] + 10, presentMode))
+            std::cout << "Unknown present mode " << argv[i] + 10 << ", using vsync" << std::endl;
+    }
+    if (runBench)
+        return Bench::Run(argc, argv);
+
+    // The render thread takes slot 0 before any job worker exists, so the
+    // workers land on the other cores (or share nothing when unpinned)
+    CpuTopology::PlaceCurrentThread(0);
+
     // Initialize GLFW
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -113,8 +318,24 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    // Key bindings
+    inputMapper.Bind(GLFW_KEY_ESCAPE, ACTION_QUIT);
+    inputMapper.Bind(GLFW_KEY_W, ACTION_WALK);
+    inputMapper.Bind(GLFW_KEY_A, ACTION_TURN_LEFT);
+    inputMapper.Bind(GLFW_KEY_D, ACTION_TURN_RIGHT);
+    inputMapper.Bind(GLFW_KEY_SPACE, ACTION_JUMP);
+    inputMapper.Bind(GLFW_KEY_1, ACTION_DANCE);
+    inputMapper.Bind(GLFW_KEY_F1, ACTION_DEBUG_OVERLAY);
+    inputMapper.Bind(GLFW_KEY_F2, ACTION_MEMORY_REPORT);
+    inputMapper.Bind(GLFW_KEY_F3, ACTION_SCHEDULER_REPORT);
+    inputMapper.Bind(GLFW_KEY_F4, ACTION_RENDER_REPORT);
+    inputMapper.Bind(GLFW_KEY_F5, ACTION_DYNAMIC_RESOLUTION);
+    inputMapper.Bind(GLFW_KEY_F6, ACTION_PRESENT_MODE);
+    inputMapper.Bind(GLFW_KEY_F7, ACTION_PROFILE_REPORT);
+
     // Load GLAD
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
@@ -129,65 +350,185 @@ int main()
     Shader ourShader("anim_model.vs", "anim_model.fs");
 
     // Load model and animations
-    ourModel = new Model(FileSystem::getPath("resources/objects/human/Rumba Dancing.dae"));
-    idleAnim = new Animation(FileSystem::getPath("resources/objects/human/Idle.dae"), ourModel);
-    walkAnim = new Animation(FileSystem::getPath("resources/objects/human/Walking.dae"), ourModel);
-    leftTurnAnim = new Animation(FileSystem::getPath("resources/objects/human/Left Turn.dae"), ourModel);
-    rightTurnAnim = new Animation(FileSystem::getPath("resources/objects/human/Right Turn.dae"), ourModel);
-    jumpAnim = new Animation(FileSystem::getPath("resources/objects/human/Forward Jump.dae"), ourModel);
-    danceAnim = new Animation(FileSystem::getPath("resources/objects/human/Rumba Dancing.dae"), ourModel);
-
-    // Start with idle
-    animator = new Animator(idleAnim);
-    currentAnim = idleAnim;
-    currentState = IDLE;
+    // A .glb exported next to each .dae is picked up automatically. The whole
+    // set is read in one batch first (--cold measures it from disk).
+    double loadStart = glfwGetTime();
+    auto humanPath = [](const char* name) { return FileSystem::getPath(std::string("resources/objects/human/") + name); };
+    std::vector<std::string> clipPaths = { humanPath("Idle.dae"), humanPath("Walking.dae"), humanPath("Left Turn.dae"),
+        humanPath("Forward Jump.dae"), humanPath("Rumba Dancing.dae") };
+    if (turnMirror == TurnMirror::Off)
+        clipPaths.push_back(humanPath("Right Turn.dae"));
+    AssetLoader::Preload({ humanPath("Rumba Dancing.dae") }, clipPaths);
+    SkinnedModel* characterModel = AssetLoader::LoadModel(humanPath("Rumba Dancing.dae"));
+    trackModelMemory(characterModel);
+    ourModel = AssetHandles::models.Publish(characterModel);
+    auto loadClip = [&](const char* name) {
+        return AssetHandles::clips.Publish(AssetLoader::LoadClip(humanPath(name), characterModel));
+    };
+    idleAnim = loadClip("Idle.dae");
+    walkAnim = loadClip("Walking.dae");
+    leftTurnAnim = loadClip("Left Turn.dae");
+    if (turnMirror == TurnMirror::Off)
+        rightTurnAnim = loadClip("Right Turn.dae");
+    jumpAnim = loadClip("Forward Jump.dae");
+    danceAnim = loadClip("Rumba Dancing.dae");
+
+    {
+        MemScope characterScope(MemTag::Characters);
+
+        // Flatten the rig once all clips have added their bones to the model
+        skeleton = new Skeleton(AssetHandles::clips.Resolve(idleAnim), characterModel);
+        clipMirror = new ClipMirror(skeleton);
+        if (turnMirror == TurnMirror::Bake)
+        {
+            MemScope clipScope(MemTag::Clips);
+            rightTurnAnim = AssetHandles::clips.Publish(clipMirror->Bake(AssetHandles::clips.Resolve(leftTurnAnim)));
+        }
+        for (ClipHandle anim : { idleAnim, walkAnim, leftTurnAnim, rightTurnAnim, jumpAnim, danceAnim })
+            if (AnimClip* clip = AssetHandles::clips.Resolve(anim))
+                skeleton->BindClip(clip);
+
+        // Sockets must be registered before any animator is created.
+        // Props are optional: drop a model at the path below to attach it.
+        int headSocket = skeleton->AddSocket("Head", "mixamorig:HeadTop_End");
+        int rightHandSocket = skeleton->AddSocket("RightHand", "mixamorig:RightHand");
+        std::string hatPath = FileSystem::getPath("resources/objects/props/hat.obj");
+        std::string swordPath = FileSystem::getPath("resources/objects/props/sword.obj");
+        if (headSocket >= 0 && std::ifstream(hatPath).good())
+            attachments.push_back({ AssetHandles::models.Publish(AssetLoader::LoadModel(hatPath)), headSocket });
+        if (rightHandSocket >= 0 && std::ifstream(swordPath).good())
+            attachments.push_back({ AssetHandles::models.Publish(AssetLoader::LoadModel(swordPath)), rightHandSocket });
+        for (const Attachment& attachment : attachments)
+            if (SkinnedModel* prop = AssetHandles::models.Resolve(attachment.model))
+                trackModelMemory(prop);
+
+        // Start with idle
+        animator = new CharacterAnimator(skeleton, idleAnim);
+        animScheduler.Add(animator, &modelPosition);
+        animScheduler.jobs = &GetJobSystem();
+        currentAnim = idleAnim;
+        currentState = IDLE;
+
+        // Clamped so a clip the measure misreads cannot play absurdly fast or slow
+        float strideSpeed = measureStrideSpeed(walkAnim);
+        if (strideSpeed > 0.0f)
+            walkRate = glm::clamp(moveSpeed / strideSpeed, 0.25f, 4.0f);
+        std::cout << "Walk clip covers " << strideSpeed << " units/s, played at " << walkRate << "x" << std::endl;
+    }
+    AsyncIO::ReleasePreloaded();
+    double loadSeconds = glfwGetTime() - loadStart;
+
+    {
+        MemScope scope(MemTag::Debug);
+        debugDraw = new DebugDraw();
+    }
+
+    // HiDPI framebuffers can be larger than the window size asked for
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    dynamicResolution = new DynamicResolution(framebufferWidth, framebufferHeight);
+    framePacer = new FramePacer(window);
+    framePacer->SetMode(presentMode);
+
+    std::cout << "Asset loads (" << loadSeconds * 1000.0 << " ms from first read to animator"
+              << (AsyncIO::dropCaches ? ", cold cache" : "") << "):" << std::endl;
+    AssetLoader::LoadReport();
+    std::cout << "Memory after loading:" << std::endl;
+    MemoryStats::Report();
 
     // Main render loop
     while (!glfwWindowShouldClose(window))
     {
+        // Assets retired by reloads in earlier frames are freed here, between
+        // frames; everything resolved below stays valid until the next pass
+        Epoch::Advance();
+        EpochScope frameEpoch;
+
+        // Input is polled after the pacer's wait so it is as fresh as the mode allows.
+        // While idle, the throttle's wait comes first and returns on any event.
+        idleThrottle.Wait();
+        framePacer->WaitForFrame();
+        glfwPollEvents();
+
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         processInput(window);
-        animator->UpdateAnimation(deltaTime);
 
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
+            dynamicResolution->GetAspect(), 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        animScheduler.Update(deltaTime, camera.Position, projection * view);
+
+        // Only the looping idle clip playing under a still camera counts as static
+        bool sceneStatic = currentState == IDLE && view == lastView && camera.Zoom == lastZoom;
+        idleThrottle.Update(currentFrame, sceneStatic);
+        lastView = view;
+        lastZoom = camera.Zoom;
+
+        dynamicResolution->BeginScene();
         glClearColor(0.05f, 0.05f, 0.08f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         ourShader.use();
-
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
-            (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
         ourShader.setMat4("projection", projection);
         ourShader.setMat4("view", view);
 
-        auto transforms = animator->GetFinalBoneMatrices();
-        for (int i = 0; i < transforms.size(); ++i)
-            ourShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+        // Bones and socket matrices go up in one call
+        std::span<const glm::mat4> transforms = animator->GetFinalBoneMatrices();
+        glUniformMatrix4fv(glGetUniformLocation(ourShader.ID, "finalBonesMatrices"),
+            (GLsizei)transforms.size(), GL_FALSE, glm::value_ptr(transforms[0]));
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, modelPosition);
         model = glm::rotate(model, modelRotation, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.5f));
+        model = glm::scale(model, glm::vec3(modelScale));
         ourShader.setMat4("model", model);
 
-        ourModel->Draw(ourShader);
+        if (SkinnedModel* characterModel = AssetHandles::models.Resolve(ourModel))
+            characterModel->Draw(ourShader);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Attachments reuse the palette and model matrix already bound above
+        for (const Attachment& attachment : attachments)
+        {
+            SkinnedModel* prop = AssetHandles::models.Resolve(attachment.model);
+            if (!prop)
+                continue;
+            ourShader.setInt("rigidBone", skeleton->GetSocketPaletteSlot(attachment.socket));
+            prop->Draw(ourShader);
+        }
+        if (!attachments.empty())
+            ourShader.setInt("rigidBone", -1);
+
+        {
+            MemScope scope(MemTag::Debug);
+            debugDraw->BeginFrame(projection * view);
+            debugDraw->AddCharacter(*animator, model);
+            debugDraw->Flush();
+        }
+        dynamicResolution->EndScene();
+
+        RenderStats::EndFrame();
+        FrameProfiler::EndFrame(deltaTime * 1000.0);
+        framePacer->Present();
     }
 
     // Cleanup
+    // Models own GL objects, so they must go before the context does.
+    // Suspended behaviours may still point at the animator.
+    behaviours.StopAll();
     delete animator;
-    delete idleAnim;
-    delete walkAnim;
-    delete leftTurnAnim;
-    delete rightTurnAnim;
-    delete jumpAnim;
-    delete danceAnim;
-    delete ourModel;
+    for (ClipHandle anim : { idleAnim, walkAnim, leftTurnAnim, rightTurnAnim, jumpAnim, danceAnim })
+        AssetHandles::clips.Release(anim);
+    AssetHandles::models.Release(ourModel);
+    for (Attachment& attachment : attachments)
+        AssetHandles::models.Release(attachment.model);
+    Epoch::FreeAll();
+    delete clipMirror;
+    delete skeleton;
+    delete debugDraw;
+    delete dynamicResolution;
+    delete framePacer;
 
     glfwTerminate();
     return 0;
@@ -195,65 +536,130 @@ int main()
 
 void processInput(GLFWwindow* window)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-
-    // Get current key states
-    bool aPressed = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
-    bool dPressed = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
-    bool spacePressed = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
-    bool onePressed = glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS;
-    bool wPressed = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
-
-    // === TURN LEFT (A) - Single press ===
-    if (aPressed && !wasAPressed && currentState != TURNING_LEFT && currentState != TURNING_RIGHT)
-    {
-        currentState = TURNING_LEFT;
-        switchAnimation(leftTurnAnim);
-        turnStartRotation = modelRotation;
-        turnTargetRotation = modelRotation - glm::radians(90.0f);
-        turnProgress = 0.0f;
-    }
-    wasAPressed = aPressed;
+    // Events were queued by key_callback since the previous frame
+    float now = lastFrame;
+    inputMapper.BeginFrame(now - deltaTime, now);
+    behaviours.Update(now);
 
-    // === TURN RIGHT (D) - Single press ===
-    if (dPressed && !wasDPressed && currentState != TURNING_LEFT && currentState != TURNING_RIGHT)
+    ActionEvent event;
+    while (inputMapper.Poll(event))
     {
-        currentState = TURNING_RIGHT;
-        switchAnimation(rightTurnAnim);
-        turnStartRotation = modelRotation;
-        turnTargetRotation = modelRotation + glm::radians(90.0f);
-        turnProgress = 0.0f;
-    }
-    wasDPressed = dPressed;
+        if (!event.pressed)
+            continue; // releases only matter for held actions, read below
 
-    // === UPDATE TURN ANIMATION ===
-    if (currentState == TURNING_LEFT || currentState == TURNING_RIGHT)
-    {
-        turnProgress += deltaTime / turnDuration;
+        bool turning = currentState == TURNING_LEFT || currentState == TURNING_RIGHT;
 
-        if (turnProgress >= 1.0f)
-        {
-            // Turn complete
-            modelRotation = turnTargetRotation;
-            currentState = IDLE;
-            switchAnimation(idleAnim);
-            turnProgress = 0.0f;
-        }
-        else
+        switch (event.action)
         {
-            // Smooth interpolation (ease-in-out)
-            float t = turnProgress;
-            t = t * t * (3.0f - 2.0f * t); // smoothstep
-            modelRotation = turnStartRotation + (turnTargetRotation - turnStartRotation) * t;
+        case ACTION_QUIT:
+            glfwSetWindowShouldClose(window, true);
+            break;
+
+        // === DEBUG OVERLAY (F1) - Toggle ===
+        case ACTION_DEBUG_OVERLAY:
+            debugDraw->enabled = !debugDraw->enabled;
+            break;
+
+        // === MEMORY REPORT (F2) ===
+        case ACTION_MEMORY_REPORT:
+            MemoryStats::Report();
+            break;
+
+        // === ANIMATION SCHEDULER REPORT (F3) ===
+        case ACTION_SCHEDULER_REPORT:
+            animScheduler.Report();
+            behaviours.Report();
+            GetPaletteSlab().Report();
+            HugePages::Report();
+            CpuTopology::Report();
+            break;
+
+        // === RENDER STATS REPORT (F4) ===
+        case ACTION_RENDER_REPORT:
+            RenderStats::Report();
+            dynamicResolution->Report();
+            framePacer->Report();
+            idleThrottle.Report();
+            break;
+
+        // === DYNAMIC RESOLUTION (F5) - Toggle ===
+        case ACTION_DYNAMIC_RESOLUTION:
+            dynamicResolution->enabled = !dynamicResolution->enabled;
+            break;
+
+        // === PRESENT MODE (F6) - Report the current mode, then cycle ===
+        case ACTION_PRESENT_MODE:
+            framePacer->Report();
+            framePacer->CycleMode();
+            std::cout << "Present mode: " << GetPresentModeName(framePacer->GetMode()) << std::endl;
+            break;
+
+        // === ANIMATION PROFILE (F7) - Print and write profile.csv ===
+        case ACTION_PROFILE_REPORT:
+            FrameProfiler::Report();
+            if (FrameProfiler::ExportCsv("profile.csv"))
+                std::cout << "Wrote profile.csv" << std::endl;
+            break;
+
+        // === TURN LEFT (A) / TURN RIGHT (D) - Single press ===
+        case ACTION_TURN_LEFT:
+        case ACTION_TURN_RIGHT:
+            if (!turning)
+            {
+                bool left = event.action == ACTION_TURN_LEFT;
+                currentState = left ? TURNING_LEFT : TURNING_RIGHT;
+                bool mirrored = !left && !rightTurnAnim.IsValid();
+                switchAnimation(left || mirrored ? leftTurnAnim : rightTurnAnim, mirrored ? clipMirror : nullptr);
+                behaviours.Start(turnBehaviour((float)event.time, modelRotation + glm::radians(left ? -90.0f : 90.0f)));
+            }
+            break;
+
+        // === JUMP (Space) - Single press ===
+        case ACTION_JUMP:
+            if (!turning && currentState != JUMPING && currentState != DANCING)
+            {
+                currentState = JUMPING;
+                switchAnimation(jumpAnim);
+                behaviours.Start(jumpBehaviour());
+            }
+            break;
+
+        // === DANCE (1) - Toggle ===
+        case ACTION_DANCE:
+            if (turning)
+                break;
+            if (currentState != DANCING)
+            {
+                currentState = DANCING;
+                switchAnimation(danceAnim);
+            }
+            else
+            {
+                currentState = IDLE;
+                switchAnimation(idleAnim);
+            }
+            break;
+
+        default:
+            break;
         }
-        return; // Block other inputs while turning
     }
 
+    // Block other inputs while turning (turnBehaviour finishes the turn)
+    if (currentState == TURNING_LEFT || currentState == TURNING_RIGHT)
+        return;
+
     // === WALK FORWARD (W) ===
-    if (wPressed)
+    // Move for as long as W was held during this frame's window. Key times
+    // are taken when glfwPollEvents delivers the events, so this has poll
+    // resolution: a tap that starts and ends within one poll adds up to
+    // nothing.
+    bool walkHeld = inputMapper.IsHeld(ACTION_WALK);
+    float walkSeconds = inputMapper.GetHeldSeconds(ACTION_WALK);
+    if (walkSeconds > 0.0f)
+        moveForward(moveSpeed * walkSeconds);
+    if (walkHeld)
     {
-        moveForward(moveSpeed * deltaTime);
         if (currentState != WALKING && currentState != DANCING)
         {
             currentState = WALKING;
@@ -266,51 +672,12 @@ void processInput(GLFWwindow* window)
         switchAnimation(idleAnim);
     }
 
-    // === JUMP (Space) - Single press ===
-    if (spacePressed && !wasSpacePressed && currentState != JUMPING && currentState != DANCING)
-    {
-        currentState = JUMPING;
-        switchAnimation(jumpAnim);
-        // Auto-return to idle after jump duration
-    }
-    wasSpacePressed = spacePressed;
-
-    // === DANCE (1) - Toggle ===
-    if (onePressed && !was1Pressed)
-    {
-        if (currentState != DANCING)
-        {
-            currentState = DANCING;
-            switchAnimation(danceAnim);
-        }
-        else
-        {
-            currentState = IDLE;
-            switchAnimation(idleAnim);
-        }
-    }
-    was1Pressed = onePressed;
-
-    // === RETURN TO IDLE ===
-    if (currentState == JUMPING)
-    {
-        // Check if jump animation might be done (simple timer)
-        static float jumpTimer = 0.0f;
-        jumpTimer += deltaTime;
-        if (jumpTimer > 1.0f) // Adjust based on your jump animation length
-        {
-            currentState = IDLE;
-            switchAnimation(idleAnim);
-            jumpTimer = 0.0f;
-        }
-    }
-
     // Auto-idle when no input (except dancing)
     if (currentState != DANCING &&
         currentState != TURNING_LEFT &&
         currentState != TURNING_RIGHT &&
         currentState != JUMPING &&
-        !wPressed)
+        !walkHeld)
     {
         if (currentState != IDLE)
         {
@@ -320,9 +687,24 @@ void processInput(GLFWwindow* window)
     }
 }
 
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    double now = glfwGetTime();
+    inputMapper.OnKey(key, action, now);
+    idleThrottle.NoteActivity(now);
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+    // Minimizing reports 0x0; keep the last real size so the aspect stays valid
+    if (width <= 0 || height <= 0)
+        return;
+    framebufferWidth = width;
+    framebufferHeight = height;
     glViewport(0, 0, width, height);
+    if (dynamicResolution)
+        dynamicResolution->Resize(width, height);
+    idleThrottle.NoteActivity(glfwGetTime());
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -340,9 +722,11 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastY = ypos;
 
     camera.ProcessMouseMovement(xoffset, yoffset);
+    idleThrottle.NoteActivity(glfwGetTime());
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(yoffset);
+    idleThrottle.NoteActivity(glfwGetTime());
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// Per-subsystem memory accounting.
+//
+// CPU bytes are counted by replacing global operator new/delete: every block
+// carries a small header with its size and the tag that was active when it was
+// allocated (see MemScope), so frees are charged back to the right subsystem
+// even when they happen outside the scope. GPU bytes are reported by the code
+// that creates buffers and textures through MemoryStats::TrackGpu.
+//
+// Define MEMORY_STATS_IMPLEMENTATION in exactly one translation unit before
+// including this header to install the allocator hooks.
+
+enum class MemTag : uint32_t
+{
+    Untagged,
+    Meshes,
+    Textures,
+    Clips,
+    ImportScratch, // any loader's scratch (Assimp, glTF, baked): freed before the load returns
+    Characters,    // skeletons, animators, per-instance state
+    Debug,
+    RenderTargets,
+    Count
+};
+
+struct MemCounter
+{
+    std::atomic<int64_t> current{ 0 };
+    std::atomic<int64_t> peak{ 0 };
+    std::atomic<int64_t> allocations{ 0 };
+
+    void Add(int64_t bytes)
+    {
+        int64_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        int64_t high = peak.load(std::memory_order_relaxed);
+        while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void Sub(int64_t bytes) { current.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    void RaisePeak(int64_t value)
+    {
+        int64_t high = peak.load(std::memory_order_relaxed);
+        while (value > high && !peak.compare_exchange_weak(high, value, std::memory_order_relaxed))
+        {
+        }
+    }
+};
+
+namespace MemoryStats
+{
+    inline MemCounter cpu[(int)MemTag::Count];
+    inline MemCounter gpu[(int)MemTag::Count];
+
+    struct ScopeState
+    {
+        MemTag tag;
+        int64_t peak;
+        ScopeState* previous;
+    };
+    inline thread_local ScopeState* currentScope = nullptr;
+
+    // 16 bytes keeps the user pointer aligned for anything operator new must support
+    struct alignas(16) BlockHeader
+    {
+        uint64_t size;
+        uint32_t tag;
+    };
+
+    inline const char* GetTagName(MemTag tag)
+    {
+        static const char* names[] = { "Untagged", "Meshes", "Textures", "Clips", "Import scratch", "Characters", "Debug", "Render targets" };
+        return names[(int)tag];
+    }
+
+    inline void* Allocate(std::size_t size)
+    {
+        BlockHeader* header = (BlockHeader*)std::malloc(sizeof(BlockHeader) + size);
+        if (!header)
+            return nullptr;
+
+        ScopeState* scope = currentScope;
+        MemTag tag = scope ? scope->tag : MemTag::Untagged;
+        header->size = size;
+        header->tag = (uint32_t)tag;
+
+        MemCounter& counter = cpu[(int)tag];
+        counter.Add((int64_t)size);
+        counter.allocations.fetch_add(1, std::memory_order_relaxed);
+        if (scope)
+        {
+            int64_t now = counter.current.load(std::memory_order_relaxed);
+            if (now > scope->peak)
+                scope->peak = now;
+        }
+        return header + 1;
+    }
+
+    inline void Free(void* ptr)
+    {
+        if (!ptr)
+            return;
+        BlockHeader* header = (BlockHeader*)ptr - 1;
+        cpu[header->tag].Sub((int64_t)header->size);
+        std::free(header);
+    }
+
+    inline void TrackGpu(MemTag tag, int64_t deltaBytes)
+    {
+        if (deltaBytes >= 0)
+            gpu[(int)tag].Add(deltaBytes);
+        else
+            gpu[(int)tag].Sub(-deltaBytes);
+    }
+
+    // Resident set size of the process as the OS sees it, or -1 if unknown.
+    // Catches what the tags cannot: mapped files, driver and malloc overhead.
+    inline int64_t GetResidentBytes()
+    {
+#ifdef __linux__
+        FILE* file = std::fopen("/proc/self/statm", "r");
+        if (!file)
+            return -1;
+        long long size = 0, resident = 0;
+        int read = std::fscanf(file, "%lld %lld", &size, &resident);
+        std::fclose(file);
+        return read == 2 ? resident * (int64_t)sysconf(_SC_PAGESIZE) : -1;
+#else
+        return -1;
+#endif
+    }
+
+    inline void Report()
+    {
+        auto mb = [](int64_t bytes) { return (double)bytes / (1024.0 * 1024.0); };
+        int64_t cpuTotal = 0, gpuTotal = 0;
+        std::printf("%-16s %12s %12s %12s %12s\n", "subsystem", "cpu MB", "cpu peak", "gpu MB", "gpu peak");
+        for (int i = 0; i < (int)MemTag::Count; ++i)
+        {
+            int64_t c = cpu[i].current.load(std::memory_order_relaxed);
+            int64_t g = gpu[i].current.load(std::memory_order_relaxed);
+            cpuTotal += c;
+            gpuTotal += g;
+            std::printf("%-16s %12.2f %12.2f %12.2f %12.2f\n", GetTagName((MemTag)i),
+                mb(c), mb(cpu[i].peak.load(std::memory_order_relaxed)),
+                mb(g), mb(gpu[i].peak.load(std::memory_order_relaxed)));
+        }
+        std::printf("%-16s %12.2f %12s %12.2f\n", "total", mb(cpuTotal), "", mb(gpuTotal));
+        int64_t resident = GetResidentBytes();
+        if (resident >= 0)
+            std::printf("%-16s %12.2f\n", "process RSS", mb(resident));
+    }
+}
+
+// Charges every allocation made on this thread to `tag` until the scope ends.
+// When `scratch` is set, whatever the scope allocated and released again before
+// it closed (e.g. the Assimp scene behind a Model or Animation) is recorded as
+// that tag's high-water mark, while the retained bytes stay with `tag`.
+class MemScope
+{
+public:
+    explicit MemScope(MemTag tag, MemTag scratch = MemTag::Count)
+        : m_Scratch(scratch)
+    {
+        m_State.tag = tag;
+        m_State.previous = MemoryStats::currentScope;
+        m_Start = MemoryStats::cpu[(int)tag].current.load(std::memory_order_relaxed);
+        m_State.peak = m_Start;
+        MemoryStats::currentScope = &m_State;
+    }
+
+    ~MemScope()
+    {
+        MemoryStats::currentScope = m_State.previous;
+        if (m_Scratch == MemTag::Count)
+            return;
+
+        MemoryStats::cpu[(int)m_Scratch].RaisePeak(GetScratchBytes());
+    }
+
+    // Bytes allocated in the scope and still live
+    int64_t GetRetainedBytes() const { return Current() - m_Start; }
+    // Bytes allocated in the scope and already released, at their worst
+    int64_t GetScratchBytes() const { return m_State.peak - Current(); }
+
+    MemScope(const MemScope&) = delete;
+    MemScope& operator=(const MemScope&) = delete;
+
+private:
+    int64_t Current() const { return MemoryStats::cpu[(int)m_State.tag].current.load(std::memory_order_relaxed); }
+
+    MemoryStats::ScopeState m_State;
+    MemTag m_Scratch;
+    int64_t m_Start;
+};
+
+#ifdef MEMORY_STATS_IMPLEMENTATION
+
+void* operator new(std::size_t size)
+{
+    if (void* p = MemoryStats::Allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (void* p = MemoryStats::Allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return MemoryStats::Allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return MemoryStats::Allocate(size); }
+
+void operator delete(void* ptr) noexcept { MemoryStats::Free(ptr); }
+void operator delete[](void* ptr) noexcept { MemoryStats::Free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { MemoryStats::Free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { MemoryStats::Free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { MemoryStats::Free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { MemoryStats::Free(ptr); }
+
+#endif
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "huge_pages.h"
+#include "memory_stats.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// Every character's skinning palette in one contiguous block. Each palette
+// starts on an ALIGNMENT boundary and is padded to a whole number of them, so
+// job workers writing the palettes of neighbouring characters never touch
+// the same cache line, and everything in use is one range [GetData(),
+// GetData() + GetUsedBytes()) that an uploader can copy with one memcpy or
+// map as one buffer, addressing a character by GetOffset.
+//
+// The block is address space reserved up front with mmap. Pages are backed
+// when first written, so the reservation costs nothing until characters fill
+// it, palettes never move, and with first touch the pages land on the NUMA
+// node of the thread that first evaluates them. Allocate and Free are for
+// the thread that creates characters; only palette contents are written from
+// workers.
+//
+// With --huge-pages the reservation is a huge-page mapping instead. Explicit
+// huge pages are taken from the pool for the whole reservation up front, so
+// size it (the constructor argument) to the crowd rather than the default.
+class PaletteSlab
+{
+public:
+    // The L2 spatial prefetcher on Intel CPUs pulls lines in 128-byte pairs,
+    // so padding to a single 64-byte line would still let neighbours collide
+    static const size_t ALIGNMENT = 128;
+    static const size_t DEFAULT_RESERVE = 64 * 1024 * 1024; // address space, ~8000 100-bone palettes
+
+    explicit PaletteSlab(size_t reserveBytes = DEFAULT_RESERVE)
+    {
+        m_Reserved = (reserveBytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (HugePages::enabled)
+        {
+            m_Mapping = HugePages::Map(m_Reserved);
+            if (m_Mapping.data)
+            {
+                m_Data = m_Mapping.data;
+                m_Reserved = m_Mapping.size;
+                return;
+            }
+        }
+#ifndef _WIN32
+        void* data = mmap(nullptr, m_Reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            std::printf("PaletteSlab: could not reserve %zu MB, palettes go to the heap\n", m_Reserved >> 20);
+            m_Reserved = 0;
+        }
+        else
+            m_Data = (unsigned char*)data;
+#else
+        m_Reserved = 0;
+#endif
+    }
+
+    ~PaletteSlab()
+    {
+        MemoryStats::cpu[(int)MemTag::Characters].Sub((int64_t)m_Used);
+        if (m_Mapping.data)
+        {
+            HugePages::Unmap(m_Mapping);
+            return;
+        }
+#ifndef _WIN32
+        if (m_Data)
+            munmap(m_Data, m_Reserved);
+#endif
+    }
+
+    PaletteSlab(const PaletteSlab&) = delete;
+    PaletteSlab& operator=(const PaletteSlab&) = delete;
+
+    // Uninitialized room for `count` matrices. A freed palette of the same
+    // padded size is reused first; past the reservation palettes come from
+    // the heap (still aligned, but no longer contiguous, and without an
+    // offset). Freed heap palettes are reused the same way.
+    glm::mat4* Allocate(size_t count)
+    {
+        size_t bytes = GetPaddedBytes(count);
+        for (size_t i = 0; i < m_Free.size(); ++i)
+        {
+            if (m_Free[i].bytes == bytes)
+            {
+                glm::mat4* palette = (glm::mat4*)(m_Data + m_Free[i].offset);
+                m_Free[i] = m_Free.back();
+                m_Free.pop_back();
+                m_LiveBytes += bytes;
+                return palette;
+            }
+        }
+        if (m_Used + bytes <= m_Reserved)
+        {
+            glm::mat4* palette = (glm::mat4*)(m_Data + m_Used);
+            m_Used += bytes;
+            m_LiveBytes += bytes;
+            // Not seen by the allocator hooks; the used part is backed once written
+            MemoryStats::cpu[(int)MemTag::Characters].Add((int64_t)bytes);
+            return palette;
+        }
+
+        for (size_t i = 0; i < m_FreeOverflow.size(); ++i)
+        {
+            OverflowPalette& block = m_Overflow[m_FreeOverflow[i]];
+            if (block.bytes == bytes)
+            {
+                m_FreeOverflow[i] = m_FreeOverflow.back();
+                m_FreeOverflow.pop_back();
+                block.live = true;
+                return block.palette;
+            }
+        }
+        MemScope scope(MemTag::Characters);
+        OverflowPalette block;
+        block.storage.reset(new unsigned char[bytes + ALIGNMENT]);
+        uintptr_t address = (uintptr_t)block.storage.get();
+        block.palette = (glm::mat4*)((address + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+        block.bytes = bytes;
+        m_Overflow.push_back(std::move(block));
+        return m_Overflow.back().palette;
+    }
+
+    void Free(glm::mat4* palette, size_t count)
+    {
+        if (!palette)
+            return;
+        if (!Contains(palette))
+        {
+            for (size_t i = 0; i < m_Overflow.size(); ++i)
+            {
+                if (m_Overflow[i].palette == palette && m_Overflow[i].live)
+                {
+                    m_Overflow[i].live = false;
+                    m_FreeOverflow.push_back(i);
+                    return;
+                }
+            }
+            assert(!"PaletteSlab::Free: not a palette of this slab");
+            return;
+        }
+        size_t bytes = GetPaddedBytes(count);
+        m_Free.push_back({ (size_t)((unsigned char*)palette - m_Data), bytes });
+        m_LiveBytes -= bytes;
+    }
+
+    bool Contains(const glm::mat4* palette) const
+    {
+        const unsigned char* p = (const unsigned char*)palette;
+        return m_Data && p >= m_Data && p < m_Data + m_Used;
+    }
+
+    const glm::mat4* GetData() const { return (const glm::mat4*)m_Data; }
+    size_t GetUsedBytes() const { return m_Used; }
+    // Matrix index of a palette in the slab, for addressing it in one
+    // uploaded buffer; INVALID_OFFSET for a palette on the heap, which the
+    // uploader has to send on its own
+    static const size_t INVALID_OFFSET = SIZE_MAX;
+    size_t GetOffset(const glm::mat4* palette) const
+    {
+        return Contains(palette) ? (size_t)(palette - GetData()) : INVALID_OFFSET;
+    }
+
+    void Report() const
+    {
+        std::printf("palette slab: %.1f KB of %zu MB reserved in use, %.1f KB live, %zu freed palettes, %zu on the heap (%zu free), %s\n",
+            m_Used / 1024.0, m_Reserved >> 20, m_LiveBytes / 1024.0, m_Free.size(), m_Overflow.size(), m_FreeOverflow.size(),
+            HugePages::GetName(m_Mapping.data ? m_Mapping.backing : HugePages::Backing::Normal));
+    }
+
+private:
+    struct FreePalette
+    {
+        size_t offset;
+        size_t bytes;
+    };
+
+    struct OverflowPalette
+    {
+        std::unique_ptr<unsigned char[]> storage;
+        glm::mat4* palette = nullptr;
+        size_t bytes = 0;
+        bool live = true;
+    };
+
+    static size_t GetPaddedBytes(size_t count)
+    {
+        return (count * sizeof(glm::mat4) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    unsigned char* m_Data = nullptr;
+    HugePages::Mapping m_Mapping; // backs m_Data with --huge-pages
+    size_t m_Reserved = 0;
+    size_t m_Used = 0;
+    size_t m_LiveBytes = 0;
+    std::vector<FreePalette> m_Free;
+    std::vector<OverflowPalette> m_Overflow;
+    std::vector<size_t> m_FreeOverflow; // indices into m_Overflow
+};
+
+// Shared slab every CharacterAnimator takes its palette from; created on first use
+inline PaletteSlab& GetPaletteSlab()
+{
+    static PaletteSlab slab;
+    return slab;
+}
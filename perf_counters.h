@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters read through perf_event_open (Linux only). One group per
+// thread, counting that thread in user space; everything else compiles to
+// no-ops and Open() returns false.
+enum PerfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+inline const char* GetPerfCounterName(int counter)
+{
+    static const char* names[] = { "cycles", "instructions", "llc_misses", "branch_misses", "dtlb_misses" };
+    return names[counter];
+}
+
+struct PerfSample
+{
+    uint64_t values[PERF_COUNTER_COUNT] = {};
+};
+
+class PerfCounterGroup
+{
+public:
+    PerfCounterGroup() = default;
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+    ~PerfCounterGroup() { Close(); }
+
+    // Fails when the kernel or a VM does not expose the PMU, or when
+    // kernel.perf_event_paranoid forbids it (3 or more on most distros)
+    bool Open()
+    {
+#ifdef __linux__
+        if (m_Leader >= 0)
+            return true;
+        // Last-level cache read misses where the PMU names them, else the
+        // generic cache-miss event (which is LLC on x86 as well)
+        const uint64_t llcReadMiss = PERF_COUNT_HW_CACHE_LL
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+        m_Leader = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (m_Leader < 0)
+            return false;
+        m_Fds[PERF_CYCLES] = m_Leader;
+        m_Fds[PERF_INSTRUCTIONS] = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, m_Leader);
+        m_Fds[PERF_LLC_MISSES] = OpenEvent(PERF_TYPE_HW_CACHE, llcReadMiss, m_Leader);
+        if (m_Fds[PERF_LLC_MISSES] < 0)
+            m_Fds[PERF_LLC_MISSES] = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, m_Leader);
+        m_Fds[PERF_BRANCH_MISSES] = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, m_Leader);
+        // Loads that missed the dTLB and needed a page walk; what huge pages cut
+        m_Fds[PERF_DTLB_MISSES] = OpenEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), m_Leader);
+
+        // Members that failed to open read as 0; note where each value lands
+        int opened = 0;
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+            m_Slot[i] = m_Fds[i] >= 0 ? opened++ : -1;
+
+        ioctl(m_Leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_Leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Close()
+    {
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            if (m_Fds[i] >= 0)
+                close(m_Fds[i]);
+            m_Fds[i] = -1;
+        }
+        m_Leader = -1;
+#endif
+    }
+
+    bool IsOpen() const { return m_Leader >= 0; }
+
+    // Running totals since Open(), scaled up if the kernel had to multiplex
+    // the group with other users of the PMU
+    bool Read(PerfSample& sample) const
+    {
+#ifdef __linux__
+        if (m_Leader < 0)
+            return false;
+        // PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING:
+        // { nr, time_enabled, time_running, value[nr] }
+        uint64_t buffer[3 + PERF_COUNTER_COUNT] = {};
+        if (read(m_Leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t)))
+            return false;
+        double scale = buffer[2] > 0 ? (double)buffer[1] / (double)buffer[2] : 1.0;
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+            sample.values[i] = m_Slot[i] >= 0 ? (uint64_t)(buffer[3 + m_Slot[i]] * scale) : 0;
+        return true;
+#else
+        (void)sample;
+        return false;
+#endif
+    }
+
+private:
+#ifdef __linux__
+    static int OpenEvent(uint32_t type, uint64_t config, int groupFd)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = groupFd < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1 /* any cpu */, groupFd, PERF_FLAG_FD_CLOEXEC);
+    }
+#endif
+
+    int m_Leader = -1;
+    int m_Fds[PERF_COUNTER_COUNT] = { -1, -1, -1, -1, -1 };
+    int m_Slot[PERF_COUNTER_COUNT] = { -1, -1, -1, -1, -1 };
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "huge_pages.h"
+#include "memory_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Per-thread bump allocator for pose scratch (local transforms and the like)
+// that only lives for one evaluation. Each thread owns its arena and creates
+// it on first use, and the block is zeroed by that thread: with Linux's
+// first-touch policy the pages land on the NUMA node the (pinned) thread runs
+// on, instead of wherever the main thread happened to be.
+//
+// Scratch is released with Rewind(mark); a Scope does that automatically.
+// With --huge-pages the block is a huge-page mapping, its capacity rounded up
+// to a whole 2 MB page.
+class PoseArena
+{
+public:
+    static const size_t DEFAULT_CAPACITY = 256 * 1024;
+
+    class Scope
+    {
+    public:
+        explicit Scope(PoseArena& arena) : m_Arena(arena), m_Mark(arena.m_Used) {}
+        ~Scope() { m_Arena.Rewind(m_Mark); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        PoseArena& m_Arena;
+        size_t m_Mark;
+    };
+
+    explicit PoseArena(size_t capacity = DEFAULT_CAPACITY)
+    {
+        Reserve(capacity);
+    }
+
+    ~PoseArena()
+    {
+        ReleaseMapping();
+    }
+
+    PoseArena(const PoseArena&) = delete;
+    PoseArena& operator=(const PoseArena&) = delete;
+
+    // The calling thread's arena
+    static PoseArena& ForThisThread()
+    {
+        thread_local PoseArena arena;
+        return arena;
+    }
+
+    // Uninitialized storage for count T's, 64-byte aligned so no two threads'
+    // poses share a cache line. Requests that do not fit go to the heap until
+    // the arena is empty again, then the block grows to cover them next time.
+    template <typename T>
+    T* Allocate(size_t count)
+    {
+        size_t bytes = (count * sizeof(T) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (m_Used + bytes <= m_Capacity)
+        {
+            T* result = reinterpret_cast<T*>(m_Data + m_Used);
+            m_Used += bytes;
+            return result;
+        }
+        m_OverflowBytes += bytes;
+        m_Overflow.push_back(NewBlock(bytes));
+        return reinterpret_cast<T*>(Align(m_Overflow.back().get()));
+    }
+
+    void Rewind(size_t mark)
+    {
+        m_Used = mark;
+        if (mark == 0 && !m_Overflow.empty())
+        {
+            m_Overflow.clear();
+            Reserve(m_Capacity + m_OverflowBytes);
+            m_OverflowBytes = 0;
+        }
+    }
+
+    size_t GetCapacity() const { return m_Capacity; }
+
+private:
+    static const size_t ALIGNMENT = 64;
+
+    static unsigned char* Align(unsigned char* p)
+    {
+        return reinterpret_cast<unsigned char*>((reinterpret_cast<uintptr_t>(p) + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+    }
+
+    static std::unique_ptr<unsigned char[]> NewBlock(size_t bytes)
+    {
+        MemScope scope(MemTag::Characters);
+        std::unique_ptr<unsigned char[]> block(new unsigned char[bytes + ALIGNMENT]);
+        std::memset(block.get(), 0, bytes + ALIGNMENT); // first touch on the owning thread
+        return block;
+    }
+
+    void Reserve(size_t capacity)
+    {
+        ReleaseMapping();
+        if (HugePages::enabled)
+        {
+            m_Mapping = HugePages::Map(capacity);
+            if (m_Mapping.data)
+            {
+                std::memset(m_Mapping.data, 0, m_Mapping.size); // first touch on the owning thread
+                MemoryStats::cpu[(int)MemTag::Characters].Add((int64_t)m_Mapping.size);
+                m_Block.reset();
+                m_Data = m_Mapping.data;
+                m_Capacity = m_Mapping.size;
+                m_Used = 0;
+                return;
+            }
+        }
+        m_Block = NewBlock(capacity);
+        m_Data = Align(m_Block.get());
+        m_Capacity = capacity;
+        m_Used = 0;
+    }
+
+    void ReleaseMapping()
+    {
+        if (!m_Mapping.data)
+            return;
+        MemoryStats::cpu[(int)MemTag::Characters].Sub((int64_t)m_Mapping.size);
+        HugePages::Unmap(m_Mapping);
+    }
+
+    std::unique_ptr<unsigned char[]> m_Block;
+    HugePages::Mapping m_Mapping; // instead of m_Block with --huge-pages
+    unsigned char* m_Data = nullptr;
+    size_t m_Capacity = 0;
+    size_t m_Used = 0;
+
+    std::vector<std::unique_ptr<unsigned char[]>> m_Overflow;
+    size_t m_OverflowBytes = 0;
+};
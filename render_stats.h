@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdio>
+
+// Per-frame counts of the GL calls that batching is meant to reduce. Code that
+// draws goes through the wrappers below; EndFrame() latches the totals so they
+// can be reported while the next frame is being counted.
+namespace RenderStats
+{
+    struct FrameCounters
+    {
+        int vaoBinds = 0;
+        int textureBinds = 0;
+        int drawCalls = 0;
+        long long triangles = 0;
+    };
+
+    inline FrameCounters current;
+    inline FrameCounters lastFrame;
+
+    inline void BindVertexArray(GLuint vao)
+    {
+        glBindVertexArray(vao);
+        if (vao)
+            current.vaoBinds++;
+    }
+
+    inline void BindTexture(GLenum unit, GLuint texture)
+    {
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        current.textureBinds++;
+    }
+
+    inline void DrawElementsBaseVertex(GLsizei indexCount, GLuint firstIndex, GLint baseVertex)
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT,
+            (const void*)(firstIndex * sizeof(GLuint)), baseVertex);
+        current.drawCalls++;
+        current.triangles += indexCount / 3;
+    }
+
+    // For draws issued directly (debug lines)
+    inline void CountDraw()
+    {
+        current.drawCalls++;
+    }
+
+    inline void EndFrame()
+    {
+        lastFrame = current;
+        current = FrameCounters();
+    }
+
+    inline void Report()
+    {
+        std::printf("last frame: %d VAO binds, %d texture binds, %d draws, %lld triangles\n",
+            lastFrame.vaoBinds, lastFrame.textureBinds, lastFrame.drawCalls, lastFrame.triangles);
+    }
+}
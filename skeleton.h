@@ -0,0 +1,137 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "anim_clip.h"
+#include "skinned_model.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Must match MAX_BONES in anim_model.vs
+const int MAX_BONES = 100;
+
+// One node of the flattened hierarchy. Nodes are stored parent-before-child,
+// so a single forward loop is enough to compute every global transform.
+struct SkeletonNode
+{
+    std::string name;
+    int parent;            // -1 for the root
+    int boneIndex;         // palette slot, -1 for helper nodes without skin
+    glm::mat4 bindLocal;   // used when the playing clip has no channel for the node
+    glm::mat4 offset;      // inverse bind matrix
+};
+
+// Named attachment point on a bone, resolved to a node index at load time
+struct BoneSocket
+{
+    std::string name;
+    int node;
+    glm::mat4 localOffset;
+};
+
+// Shared, read-only description of a character's rig. Built once after the
+// model and all of its clips are loaded, so no per-frame name lookups are needed.
+class Skeleton
+{
+public:
+    Skeleton(const AnimClip* clip, SkinnedModel* model)
+    {
+        auto& boneInfoMap = model->GetBoneInfoMap();
+        for (const ClipNode& src : clip->GetNodes())
+        {
+            SkeletonNode node;
+            node.name = src.name;
+            node.parent = src.parent;
+            node.bindLocal = src.bindLocal;
+            node.boneIndex = -1;
+            node.offset = glm::mat4(1.0f);
+
+            auto it = boneInfoMap.find(src.name);
+            if (it != boneInfoMap.end())
+            {
+                node.boneIndex = it->second.id;
+                node.offset = it->second.offset;
+            }
+            m_Nodes.push_back(node);
+        }
+        m_BoneCount = model->GetBoneCount();
+    }
+
+    // Resolve every track of the clip to a node once, so the hierarchy pass
+    // can index tracks directly instead of searching by name per node per frame.
+    // Entries are track indices, -1 where the clip leaves the node at bind pose.
+    // Bindings are keyed by address and checked by serial, so a reloaded clip
+    // that lands at a freed clip's address is bound afresh.
+    const std::vector<int>& BindClip(const AnimClip* clip)
+    {
+        ClipBinding& binding = m_ClipBindings[clip];
+        if (binding.serial == clip->GetSerial())
+            return binding.tracks;
+
+        binding.serial = clip->GetSerial();
+        binding.tracks.assign(m_Nodes.size(), -1);
+        for (size_t i = 0; i < m_Nodes.size(); ++i)
+            binding.tracks[i] = clip->FindTrack(m_Nodes[i].name);
+        return binding.tracks;
+    }
+
+    // Returns the socket index, or -1 when the bone does not exist in the rig
+    int AddSocket(const std::string& name, const std::string& boneName,
+        const glm::mat4& localOffset = glm::mat4(1.0f))
+    {
+        int node = FindNode(boneName);
+        if (node < 0)
+        {
+            std::cout << "Socket " << name << ": no bone named " << boneName << std::endl;
+            return -1;
+        }
+        if (m_BoneCount + (int)m_Sockets.size() >= MAX_BONES)
+        {
+            std::cout << "Socket " << name << ": palette is full" << std::endl;
+            return -1;
+        }
+        m_Sockets.push_back({ name, node, localOffset });
+        return (int)m_Sockets.size() - 1;
+    }
+
+    int FindNode(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_Nodes.size(); ++i)
+            if (m_Nodes[i].name == name)
+                return (int)i;
+        return -1;
+    }
+
+    int FindSocket(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_Sockets.size(); ++i)
+            if (m_Sockets[i].name == name)
+                return (int)i;
+        return -1;
+    }
+
+    const std::vector<SkeletonNode>& GetNodes() const { return m_Nodes; }
+    const std::vector<BoneSocket>& GetSockets() const { return m_Sockets; }
+    int GetBoneCount() const { return m_BoneCount; }
+
+    // Socket matrices are appended to the palette right after the bones so
+    // attached props are drawn with the same uniform upload as the skin.
+    int GetSocketPaletteSlot(int socket) const { return m_BoneCount + socket; }
+    int GetPaletteSize() const { return m_BoneCount + (int)m_Sockets.size(); }
+
+private:
+    std::vector<SkeletonNode> m_Nodes;
+    std::vector<BoneSocket> m_Sockets;
+    struct ClipBinding
+    {
+        uint64_t serial = 0;
+        std::vector<int> tracks;
+    };
+
+    std::unordered_map<const AnimClip*, ClipBinding> m_ClipBindings;
+    int m_BoneCount = 0;
+};
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <learnopengl/assimp_glm_helpers.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/shader_m.h>
+
+#include "async_io.h"
+#include "import_profile.h"
+#include "job_system.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Same GL setup as TextureFromFile, for pixels that are already decoded
+inline unsigned int UploadTexture(const unsigned char* pixels, int width, int height, int components)
+{
+    GLenum format = components == 1 ? GL_RED : components == 3 ? GL_RGB : GL_RGBA;
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// Range of the model's shared buffers drawn with one material
+struct SubMesh
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+    std::vector<Texture> textures;
+};
+
+// Same shape as LearnOpenGL's Model (meshes, textures, bone map) but it can be
+// filled by any loader: the tuned Assimp path below or the glTF fast path.
+// Instead of one Mesh (and VAO/VBO/EBO) per mesh, all meshes are appended to
+// one vertex and one index buffer behind a single VAO and drawn by offset.
+class SkinnedModel
+{
+public:
+    std::vector<Texture> textures_loaded;
+    std::vector<SubMesh> meshes;
+    std::string directory;
+
+    SkinnedModel() = default;
+    SkinnedModel(const SkinnedModel&) = delete;
+    SkinnedModel& operator=(const SkinnedModel&) = delete;
+
+    ~SkinnedModel()
+    {
+        if (m_VAO)
+        {
+            glDeleteVertexArrays(1, &m_VAO);
+            glDeleteBuffers(1, &m_VBO);
+            glDeleteBuffers(1, &m_EBO);
+        }
+    }
+
+    // Appends a mesh to the shared buffers; call Upload() once all are added
+    void AddMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures)
+    {
+        SubMesh mesh;
+        mesh.firstIndex = (unsigned int)m_Indices.size();
+        mesh.indexCount = (unsigned int)indices.size();
+        mesh.baseVertex = (int)m_Vertices.size();
+        mesh.textures = textures;
+        meshes.push_back(mesh);
+        m_Vertices.insert(m_Vertices.end(), vertices.begin(), vertices.end());
+        m_Indices.insert(m_Indices.end(), indices.begin(), indices.end());
+    }
+
+    // Sends the meshes added so far to GL. The CPU copies stay around until
+    // ReleaseCpuData() so the model can still be baked or skinned on the CPU.
+    void Upload()
+    {
+        UploadBuffers(m_Vertices.data(), m_Vertices.size(), m_Indices.data(), m_Indices.size());
+    }
+
+    // Upload from data already in GPU layout (a mapped baked file); nothing is
+    // copied on the CPU side
+    void UploadFromMemory(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount)
+    {
+        UploadBuffers(vertices, vertexCount, indices, indexCount);
+    }
+
+    void ReleaseCpuData()
+    {
+        std::vector<Vertex>().swap(m_Vertices);
+        std::vector<unsigned int>().swap(m_Indices);
+    }
+
+    bool HasCpuData() const { return !m_Vertices.empty(); }
+    const std::vector<Vertex>& GetVertices() const { return m_Vertices; }
+    const std::vector<unsigned int>& GetIndices() const { return m_Indices; }
+
+    // One VAO bind per model; textures are only rebound when the material changes
+    void Draw(Shader& shader)
+    {
+        if (!m_VAO)
+            return;
+        RenderStats::BindVertexArray(m_VAO);
+        const std::vector<Texture>* bound = nullptr;
+        for (const SubMesh& mesh : meshes)
+        {
+            if (!bound || !SameTextures(*bound, mesh.textures))
+            {
+                BindTextures(shader, mesh.textures);
+                bound = &mesh.textures;
+            }
+            RenderStats::DrawElementsBaseVertex((GLsizei)mesh.indexCount, mesh.firstIndex, mesh.baseVertex);
+        }
+        RenderStats::BindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    size_t GetVertexBytes() const { return m_VertexCount * sizeof(Vertex); }
+    size_t GetIndexBytes() const { return m_IndexCount * sizeof(unsigned int); }
+
+    std::map<std::string, BoneInfo>& GetBoneInfoMap() { return m_BoneInfoMap; }
+    const std::map<std::string, BoneInfo>& GetBoneInfoMap() const { return m_BoneInfoMap; }
+    int& GetBoneCount() { return m_BoneCounter; }
+
+    // Returns the palette slot for a bone, registering it on first sight
+    int AddBone(const std::string& name, const glm::mat4& offset)
+    {
+        auto it = m_BoneInfoMap.find(name);
+        if (it != m_BoneInfoMap.end())
+            return it->second.id;
+        BoneInfo info;
+        info.id = m_BoneCounter++;
+        info.offset = offset;
+        m_BoneInfoMap[name] = info;
+        return info.id;
+    }
+
+    // Reads (path, type) pairs relative to `directory` in one I/O batch,
+    // decodes them from memory in parallel and uploads them in order into
+    // textures_loaded; failed files keep id 0
+    void LoadTextureFiles(const std::vector<std::pair<std::string, std::string>>& files)
+    {
+        AsyncIO::ReadBatch batch;
+        for (const auto& file : files)
+            batch.Add(directory + '/' + file.first);
+        batch.Read();
+
+        std::vector<DecodedImage> images(files.size());
+        GetJobSystem().ParallelFor(files.size(), [&](size_t t) {
+            const AsyncIO::FileData& file = batch.Get(t);
+            if (file.ok)
+                images[t].pixels = stbi_load_from_memory(file.data, (int)file.size, &images[t].width, &images[t].height,
+                    &images[t].components, 0);
+        });
+
+        for (size_t t = 0; t < files.size(); ++t)
+        {
+            Texture texture;
+            texture.type = files[t].second;
+            texture.path = files[t].first;
+            texture.id = 0;
+            if (images[t].pixels)
+            {
+                texture.id = UploadTexture(images[t].pixels, images[t].width, images[t].height, images[t].components);
+                stbi_image_free(images[t].pixels);
+            }
+            else
+                std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+            textures_loaded.push_back(texture);
+        }
+    }
+
+    // Everything that does not touch GL (vertex/weight conversion, image
+    // decoding) runs per mesh / per texture on the job system; GL objects
+    // are created afterwards on the calling thread.
+    static SkinnedModel* LoadAssimp(const std::string& path, ImportProfile profile = ImportProfile::SkinOnly)
+    {
+        Assimp::Importer importer;
+        unsigned int flags = ConfigureImporter(importer, profile);
+        const aiScene* scene = ReadScene(importer, path, flags);
+        if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode)
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return nullptr;
+        }
+
+        SkinnedModel* model = new SkinnedModel();
+        model->directory = path.substr(0, path.find_last_of('/'));
+
+        // Same mesh order as Model::processNode
+        std::vector<const aiMesh*> sourceMeshes;
+        CollectMeshes(scene, scene->mRootNode, sourceMeshes);
+
+        // Bone ids are handed out serially so they do not depend on scheduling
+        std::vector<std::vector<int>> meshBoneIds(sourceMeshes.size());
+        for (size_t m = 0; m < sourceMeshes.size(); ++m)
+        {
+            const aiMesh* mesh = sourceMeshes[m];
+            for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+                meshBoneIds[m].push_back(model->AddBone(mesh->mBones[b]->mName.C_Str(),
+                    AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[b]->mOffsetMatrix)));
+        }
+
+        std::vector<MeshData> meshData(sourceMeshes.size());
+        GetJobSystem().ParallelFor(sourceMeshes.size(), [&](size_t m) {
+            MemScope scope(MemTag::Meshes);
+            ConvertMesh(sourceMeshes[m], meshBoneIds[m], profile, meshData[m]);
+        });
+
+        // Unique texture files, decoded in parallel, uploaded here
+        std::vector<std::pair<std::string, std::string>> textureFiles; // (path, type)
+        std::vector<std::vector<int>> meshTextures(sourceMeshes.size());
+        for (size_t m = 0; m < sourceMeshes.size(); ++m)
+            CollectTextures(scene->mMaterials[sourceMeshes[m]->mMaterialIndex], profile, textureFiles, meshTextures[m]);
+
+        model->LoadTextureFiles(textureFiles);
+
+        for (size_t m = 0; m < sourceMeshes.size(); ++m)
+        {
+            std::vector<Texture> textures;
+            for (int t : meshTextures[m])
+                if (model->textures_loaded[t].id)
+                    textures.push_back(model->textures_loaded[t]);
+            model->AddMesh(meshData[m].vertices, meshData[m].indices, textures);
+            meshData[m] = MeshData();
+        }
+        model->Upload();
+        return model;
+    }
+
+private:
+    // Same attribute layout as Mesh::setupMesh, once for the whole model
+    void UploadBuffers(const void* vertices, size_t vertexCount, const void* indices, size_t indexCount)
+    {
+        m_VertexCount = vertexCount;
+        m_IndexCount = indexCount;
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(1, &m_VBO);
+        glGenBuffers(1, &m_EBO);
+
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        glBindVertexArray(0);
+    }
+
+    struct MeshData
+    {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+    };
+
+    struct DecodedImage
+    {
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0, components = 0;
+    };
+
+    static bool SameTextures(const std::vector<Texture>& a, const std::vector<Texture>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if (a[i].id != b[i].id || a[i].type != b[i].type)
+                return false;
+        return true;
+    }
+
+    // Same sampler naming as Mesh::Draw (texture_diffuse1, texture_specular1, ...)
+    static void BindTextures(Shader& shader, const std::vector<Texture>& textures)
+    {
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr = 1;
+        unsigned int heightNr = 1;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            std::string number;
+            const std::string& name = textures[i].type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++);
+            else if (name == "texture_normal")
+                number = std::to_string(normalNr++);
+            else if (name == "texture_height")
+                number = std::to_string(heightNr++);
+            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            RenderStats::BindTexture(GL_TEXTURE0 + i, textures[i].id);
+        }
+    }
+
+    static void CollectMeshes(const aiScene* scene, const aiNode* node, std::vector<const aiMesh*>& out)
+    {
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+            out.push_back(scene->mMeshes[node->mMeshes[i]]);
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            CollectMeshes(scene, node->mChildren[i], out);
+    }
+
+    static void ConvertMesh(const aiMesh* mesh, const std::vector<int>& boneIds, ImportProfile profile, MeshData& out)
+    {
+        bool tangents = profile == ImportProfile::Full && mesh->HasTangentsAndBitangents();
+        out.vertices.resize(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex& vertex = out.vertices[i];
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+            {
+                vertex.m_BoneIDs[j] = -1;
+                vertex.m_Weights[j] = 0.0f;
+            }
+            vertex.Position = AssimpGLMHelpers::GetGLMVec(mesh->mVertices[i]);
+            vertex.Normal = mesh->HasNormals() ? AssimpGLMHelpers::GetGLMVec(mesh->mNormals[i]) : glm::vec3(0.0f);
+            vertex.TexCoords = mesh->mTextureCoords[0]
+                ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+            vertex.Tangent = tangents ? AssimpGLMHelpers::GetGLMVec(mesh->mTangents[i]) : glm::vec3(0.0f);
+            vertex.Bitangent = tangents ? AssimpGLMHelpers::GetGLMVec(mesh->mBitangents[i]) : glm::vec3(0.0f);
+        }
+
+        out.indices.reserve(mesh->mNumFaces * 3);
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            for (unsigned int j = 0; j < face.mNumIndices; j++)
+                out.indices.push_back(face.mIndices[j]);
+        }
+
+        // Same slot filling as Model::ExtractBoneWeightForVertices
+        for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+        {
+            const aiBone* bone = mesh->mBones[b];
+            for (unsigned int w = 0; w < bone->mNumWeights; ++w)
+            {
+                unsigned int vertexId = bone->mWeights[w].mVertexId;
+                if (vertexId >= out.vertices.size())
+                    continue;
+                Vertex& vertex = out.vertices[vertexId];
+                for (int j = 0; j < MAX_BONE_INFLUENCE; ++j)
+                {
+                    if (vertex.m_BoneIDs[j] < 0)
+                    {
+                        vertex.m_BoneIDs[j] = boneIds[b];
+                        vertex.m_Weights[j] = bone->mWeights[w].mWeight;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    static void CollectTextures(const aiMaterial* material, ImportProfile profile,
+        std::vector<std::pair<std::string, std::string>>& files, std::vector<int>& meshTextures)
+    {
+        // Type names follow Model::processMesh; only diffuse is sampled by anim_model.fs
+        static const std::pair<aiTextureType, const char*> fullSet[] = {
+            { aiTextureType_DIFFUSE, "texture_diffuse" },
+            { aiTextureType_SPECULAR, "texture_specular" },
+            { aiTextureType_HEIGHT, "texture_normal" },
+            { aiTextureType_AMBIENT, "texture_height" } };
+        size_t typeCount = profile == ImportProfile::Full ? 4 : 1;
+
+        for (size_t k = 0; k < typeCount; ++k)
+        {
+            for (unsigned int i = 0; i < material->GetTextureCount(fullSet[k].first); i++)
+            {
+                aiString str;
+                material->GetTexture(fullSet[k].first, i, &str);
+                int index = -1;
+                for (size_t f = 0; f < files.size(); ++f)
+                    if (files[f].first == str.C_Str())
+                        index = (int)f;
+                if (index < 0)
+                {
+                    index = (int)files.size();
+                    files.push_back({ str.C_Str(), fullSet[k].second });
+                }
+                meshTextures.push_back(index);
+            }
+        }
+    }
+
+    std::map<std::string, BoneInfo> m_BoneInfoMap;
+    int m_BoneCounter = 0;
+
+    std::vector<Vertex> m_Vertices;
+    std::vector<unsigned int> m_Indices;
+    size_t m_VertexCount = 0;
+    size_t m_IndexCount = 0;
+    unsigned int m_VAO = 0;
+    unsigned int m_VBO = 0;
+    unsigned int m_EBO = 0;
+};
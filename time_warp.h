@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+// Monotonic remapping of a clip's normalized cycle position, e.g. to hold the
+// contact poses of a walk a little longer or to line its footfalls up with
+// another clip. The curve is stored as uniform samples, so evaluating it per
+// character per frame is one multiply, one table index and one lerp.
+class TimeWarp
+{
+public:
+    static const int SAMPLES = 33;
+
+    TimeWarp()
+    {
+        for (int i = 0; i < SAMPLES; ++i)
+            m_Values[i] = (float)i / (SAMPLES - 1);
+    }
+
+    // Piecewise linear through the points, x and y in [0, 1] with x
+    // ascending; (0, 0) and (1, 1) are implied. A point below its predecessor
+    // is raised to it, so the warp never plays backwards.
+    TimeWarp(std::initializer_list<glm::vec2> points)
+    {
+        std::vector<glm::vec2> curve;
+        curve.push_back(glm::vec2(0.0f, 0.0f));
+        for (const glm::vec2& point : points)
+            if (point.x > curve.back().x && point.x < 1.0f)
+                curve.push_back(glm::vec2(point.x, glm::clamp(point.y, curve.back().y, 1.0f)));
+        curve.push_back(glm::vec2(1.0f, 1.0f));
+
+        size_t segment = 0;
+        for (int i = 0; i < SAMPLES; ++i)
+        {
+            float x = (float)i / (SAMPLES - 1);
+            while (segment + 2 < curve.size() && curve[segment + 1].x < x)
+                segment++;
+            const glm::vec2& a = curve[segment];
+            const glm::vec2& b = curve[segment + 1];
+            m_Values[i] = glm::mix(a.y, b.y, glm::clamp((x - a.x) / (b.x - a.x), 0.0f, 1.0f));
+        }
+    }
+
+    float Evaluate(float position) const
+    {
+        float x = glm::clamp(position, 0.0f, 1.0f) * (SAMPLES - 1);
+        int i = std::min((int)x, SAMPLES - 2);
+        return m_Values[i] + (m_Values[i + 1] - m_Values[i]) * (x - i);
+    }
+
+private:
+    float m_Values[SAMPLES];
+};